@@ -0,0 +1,122 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Counts heap allocations per thread and per phase of the frame.
+/// The counting itself comes from replacements of the global operator new and delete, only compiled in
+/// with TRACK_ALLOCATIONS (premake5 --track-allocations). Without it phases are still tagged, but nothing
+/// is counted and the panel stays hidden.
+/// A phase can be guarded: once the loop reached steady state, a guarded phase that allocates in a frame
+/// is reported, and debug builds can assert on it.
+class AllocationTracker
+{
+public:
+#ifdef TRACK_ALLOCATIONS
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  static constexpr uint32_t MAX_THREADS = 64;
+
+  // frames skipped after guarding a phase, for pools and caches to reach their size
+  static constexpr uint64_t WARMUP_FRAMES = 120;
+
+  enum class Phase : uint8_t
+  {
+    other,
+    events,
+    update,
+    render,
+    ui,
+    count,
+  };
+
+  struct Counters
+  {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+  };
+
+  /// Tags the allocations of the calling thread with phase until the end of the scope.
+  class Scope
+  {
+  public:
+    explicit Scope(Phase phase) : m_previous(AllocationTracker::enter(phase)) {}
+    ~Scope() { AllocationTracker::enter(m_previous); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Phase m_previous;
+  };
+
+  static AllocationTracker &get();
+
+  /// Names the calling thread in the panel.
+  static void setThreadName(const char *name);
+
+  /// Hooks of the operator new and delete replacements, never allocate.
+  static void onAllocate(size_t size);
+  static void onFree();
+
+  /// Takes the counts of the frame that just ended, from the thread running the frames.
+  void endFrame();
+
+  /// Guarded phases are checked by every endFrame() after the warm up, from any thread.
+  void guard(Phase phase, bool enabled);
+  bool guarded(Phase phase) const;
+
+  /// Debug builds only, asserts in the allocation itself so the debugger stops on the culprit.
+  void setAssert(bool enabled);
+  bool asserting() const;
+
+  uint64_t violations() const { return m_violations.load(std::memory_order_relaxed); }
+
+  /// Allocations of the last frame, all threads and phases together.
+  Counters lastFrame() const;
+
+  void drawUi(bool *open = nullptr);
+
+  static const char *phaseName(Phase phase);
+
+private:
+  static constexpr size_t PHASES = (size_t)Phase::count;
+
+  struct Thread
+  {
+    std::atomic<uint64_t> allocations[PHASES];
+    std::atomic<uint64_t> frees[PHASES];
+    std::atomic<uint64_t> bytes[PHASES];
+
+    char name[32] = {};
+    std::atomic<bool> named = false;
+  };
+
+  static Phase enter(Phase phase);
+  static Thread &local();
+
+  // constant initialized, so they are usable by the very first allocation of the program
+  static Thread s_threads[MAX_THREADS];
+  static std::atomic<uint32_t> s_threadCount;
+
+  AllocationTracker() = default;
+
+  // taken by endFrame() and by readers of the frame counts, neither allocates
+  mutable std::mutex m_lock;
+  uint64_t m_frame = 0;
+  Counters m_totals[MAX_THREADS][PHASES] = {};
+  Counters m_last[MAX_THREADS][PHASES] = {};
+
+  uint32_t m_lastViolationThread = 0;
+  Phase m_lastViolationPhase = Phase::other;
+
+  std::atomic<uint32_t> m_guarded = 0;
+  std::atomic<uint64_t> m_guardedSince = 0;
+  std::atomic<uint64_t> m_violations = 0;
+};
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "Application.hpp"
+#include "Cloth.hpp"
+#include "ClothCompute.hpp"
 
-class App : public Application
+#include <atomic>
+
+class App : public StaticApplication<App>
 {
 public:
   virtual void init() override;
@@ -14,18 +18,82 @@ public:
   virtual void render() override;
 
 private:
+  static constexpr uint32_t cloth_resolution = 256;
+  static constexpr float cloth_size = 1.0f;
+  static constexpr glm::vec3 cloth_top = { 0.0f, 0.5f, 0.0f };
+
+  static constexpr double tick_rate = 60.0;
+
+  // rows interpolated and recorded by each render job
+  static constexpr uint32_t band_rows = 32;
+
+  // the compute path catches up on at most this many ticks per frame, and is checked against the CPU over validation_steps
+  // on a validation_resolution grid, one step per frame so the check never holds up rendering
+  static constexpr uint32_t max_gpu_ticks = 4;
+  static constexpr uint32_t validation_steps = 30;
+  static constexpr uint32_t validation_resolution = 32;
 
-  glm::vec3 positions[3] = {
-    {  0.0f,  0.5f, 0.0f },
-    { -0.5f, -0.5f, 0.0f },
-    {  0.5f, -0.5f, 0.0f }
+  // the cloth hangs from its top row, it never gets further than its diagonal from there
+  static constexpr float bounding_radius = cloth_size * 1.5f;
+
+  // update thread only
+  float m_time = 0.0f;
+  Cloth m_cloth;
+  std::vector<glm::vec3> m_positions;
+
+  // the last two simulated steps, interpolated by the render thread
+  struct ClothState
+  {
+    std::vector<glm::vec3> previous;
+    std::vector<glm::vec3> current;
   };
 
+  // written by the update thread, read by the render thread
+  TripleBuffer<ClothState> m_state;
+  std::atomic<float> m_stepTime = 0.0f;
+
+  // the same cloth simulated by compute shaders, stepped by the render thread for every tick the update thread counts
+  ClothCompute m_gpu_cloth;
+  bool m_gpu_supported = false; // set by init(), the UI can't ask the GL thread
+  std::atomic<bool> m_use_gpu = false;
+  std::atomic<uint32_t> m_pending_ticks = 0;
+  float m_gpu_time = 0.0f;
+
+  // requested by the UI, run on the GL thread next to the simulation rather than in its place
+  std::atomic<bool> m_validate = false;
+  std::atomic<float> m_gpu_error = -1.0f;
+  Cloth m_validation_cloth;
+  ClothCompute m_validation_gpu;
+  uint32_t m_validation_left = 0;
 
+  void draw();
+  void validate();
 
-  Shader m_shader;
+  static void set_instance(const RenderBatch::Instance &instance);
+
+  // std140 mirror of the uniform block in cloth.vert
+  struct FrameUniforms
+  {
+    glm::mat4 viewProjection;
+  };
+
+  static constexpr GLuint FRAME_BINDING = 0;
+
+  // attribute locations fixed by the layout qualifiers of cloth.vert, known before the program is linked
+  static constexpr GLuint POSITION_LOCATION = 0;
+  static constexpr GLuint COLOR_LOCATION = 1;
+
+  // owned by the shader library
+  Shader *m_shader = nullptr;
+
+  // interpolated positions are written straight into mapped memory every frame
+  StreamingBuffer m_position_stream;
 
   GLuint m_vertex_array = 0;
-  GLuint m_position_buffer = 0;
+  GLuint m_command_vertex_array = 0;
   GLuint m_color_buffer = 0;
+  GLuint m_index_buffer = 0;
+
+  // the cloth as registered with the render batch
+  uint32_t m_mesh = 0;
 };
@@ -4,17 +4,74 @@
 #include "Camera.hpp"
 
 #include "Shader.hpp"
-
+#include "TripleBuffer.hpp"
+#include "FramePacer.hpp"
+#include "JobSystem.hpp"
+#include "StreamingBuffer.hpp"
+#include "UniformBuffer.hpp"
+#include "ShaderLibrary.hpp"
+#include "ShaderReloader.hpp"
+#include "RenderBatch.hpp"
+#include "CommandList.hpp"
+#include "Profiler.hpp"
+#include "SpscQueue.hpp"
+#include "FrameArena.hpp"
+#include "AllocationTracker.hpp"
+
+#include <imgui.h>
+
+#include <chrono>
 #include <vector>
 #include <thread>
+#include <cstddef>
+#include <filesystem>
+#include <algorithm>
+#include <type_traits>
+
 
 class Application
 {
 public:
   Application();
-  void run();
+
+  /// Runs until the window closes, or for frameCount frames when it isn't 0.
+  void run(Window::Mode mode = Window::Mode::windowed, uint64_t frameCount = 0);
+
+  /// Runs update() at a fixed rate instead of once per loop iteration, 0 restores the variable timestep.
+  /// Must be called before run() or from init().
+  void setTickRate(double ticksPerSecond);
+
+  /// Renders from a thread of its own that owns the GL context, the main thread only polls events,
+  /// builds the ui and forwards input to it. Ignored by headless runs, which have no events to wait for.
+  /// Must be called before run() or from init().
+  void setRenderThread(bool enabled);
+
+  /// Writes the last frame to path as a binary PPM once the loop ended, for regression checks.
+  /// Headless runs only, must be called before run().
+  void setFrameDump(const std::filesystem::path &path);
 
 protected:
+  /// Progress of the render side between the last two fixed updates, in [0, 1].
+  /// Always 1 when the update loop runs with a variable timestep.
+  float interpolation() const;
+
+  /// Runs the loops with update(), render() and update_ui() called on hooks, see StaticApplication.
+  template <typename Hooks>
+  void _run(Hooks &hooks, Window::Mode mode, uint64_t frameCount);
+
+  /// Scratch memory of the calling thread, valid until the end of the current update(), render() or
+  /// update_ui() call, or of the current job on a job thread. Allocating from it never touches the heap
+  /// once it has grown to a frame's worth.
+  FrameArena &frameArena() const { return FrameArena::local(); }
+
+  /// The keyboard and mouse as of the start of the newest frame, from update() only.
+  /// Valid until the next call.
+  const InputState &input() { return window.input().latest(); }
+
+  /// Scheduling accuracy of the main loop and of the update loop.
+  FramePacer::Stats framePacing() const { return m_framePacer.stats(); }
+  FramePacer::Stats updatePacing() const { return m_updatePacer.stats(); }
+
   virtual void init() {};
   virtual void stop() {};
 
@@ -24,19 +81,70 @@ protected:
   virtual void update_ui() {};
 
 private:
-  void loop();
-  void updateLoop();
-  void renderLoop();
+  using loop_clock = std::chrono::steady_clock;
+  using clock_unit = std::chrono::duration<float>;
 
-  void timed_loop(std::function<bool(void)> conditionChecker, std::function<void(float)> function);
+  template <typename Hooks> void loop(Hooks &hooks);
+  template <typename Hooks> void updateLoop(Hooks &hooks);
+  template <typename Hooks> void renderLoop(Hooks &hooks);
 
-  void _init();
+  /// Templated on the callables so they can be inlined into the loop.
+  /// schedule, when given, tells when the next iteration may start from when the last one did.
+  template <typename Condition, typename Function, typename Schedule = std::nullptr_t>
+  void timed_loop(FramePacer &pacer, Condition conditionChecker, Function function, Schedule schedule = nullptr);
+  template <typename Condition, typename Function>
+  void fixed_loop(FramePacer &pacer, Condition conditionChecker, Function function);
+
+  void _init(Window::Mode mode);
   void _stop();
 
-  void _update_ui();
+  bool _dump_frame(const std::filesystem::path &path) const;
+
+  template <typename Hooks> void _update_ui(Hooks &hooks);
+
+  template <typename Hooks> void _render(Hooks &hooks);
+  template <typename Hooks> void _update(Hooks &hooks, float timestep);
+
+  // what the above do around the hooks
+  void _begin_ui();
+  void _end_ui();
+  void _publish_ui();
+  void _begin_render();
+  void _end_render();
+
+  // window events handled on the main thread, applied by the render thread before its next frame
+  struct WindowEvent
+  {
+    enum class Type { resize, key } type;
+
+    int width = 0;
+    int height = 0;
+    int key = 0;
+  };
+
+  void _forward(const WindowEvent &event);
+  void _forward_backlog();
+  void _process_events();
+  void _process_input(float timestep);
+
+  void _camera_key(int key);
+
+  // a deep copy of ImGui's draw data, into draw lists owned by the slot
+  struct UiFrame
+  {
+    UiFrame() = default;
+    ~UiFrame();
+
+    UiFrame(const UiFrame &) = delete;
+    UiFrame &operator=(const UiFrame &) = delete;
 
-  void _render();
-  void _update(float timestep);
+    void copy(ImDrawData &source);
+
+    ImDrawData drawData;
+
+    // every list this slot ever needed, reused so copying stops allocating once they are large enough
+    ImVector<ImDrawList *> lists;
+  };
 
 public:
   virtual void onResize(Window &window, int width, int height);
@@ -49,11 +157,89 @@ protected:
   Camera camera;
   Window window;
 
+  // update() and render() may spread their work across every core through it
+  JobSystem jobs;
+
+  // per-frame and per-object uniform blocks, staged by render() and bound by offset
+  UniformBuffer uniforms;
+
+  // programs loaded by init() are compiled together and ready once it returns
+  ShaderLibrary shaders;
+
+  // shaders registered here are rebuilt in the background when their files change
+  ShaderReloader shaderReloader;
+
+  // draws submitted by render() are sorted and issued as instanced draws after it returns
+  RenderBatch batch;
+
+  // render() may record draws from jobs with commands.record(), they are replayed once it returns
+  CommandQueue commands;
+
 private:
+  static constexpr GLsizeiptr UNIFORMS_PER_FRAME = 1 << 20;
+  static constexpr uint32_t INSTANCES_PER_FRAME = 1 << 16;
+
   std::atomic<bool> running = false;
   glm::dvec2 m_cursorSave = { 0, 0 };
 
+  std::atomic<uint64_t> m_frame = 0;
+  uint64_t m_frameLimit = 0;
+
+  std::filesystem::path m_dumpPath;
+
+  bool m_showProfiler = true;
+  bool m_showAllocations = AllocationTracker::ENABLED;
+
 private:
   std::atomic<bool> m_updating;
   std::thread m_updateThread;
-};
\ No newline at end of file
+
+  FramePacer m_framePacer;
+  FramePacer m_updatePacer;
+
+  std::chrono::steady_clock::duration m_tickInterval = std::chrono::steady_clock::duration::zero();
+  std::atomic<std::chrono::steady_clock::rep> m_lastTick = 0;
+
+private:
+  bool m_useRenderThread = false;
+  std::thread m_renderThread;
+
+  SpscQueue<WindowEvent> m_events{ 256 };
+  // events the queue had no room for, main thread only
+  std::vector<WindowEvent> m_eventBacklog;
+
+  // the snapshot the camera last moved from, frame thread only
+  InputState m_lastInput;
+
+  TripleBuffer<UiFrame> m_uiFrames;
+  // set by the main thread once it published a ui frame, cleared when the render thread picked it up
+  std::atomic<bool> m_uiPending = false;
+};
+
+/// Application with update(), render() and update_ui() resolved at compile time: the loops call those of
+/// Derived directly, so the compiler can inline them, where Application goes through the vtable.
+/// Derived declares its hooks as it would for Application, accessible from this class.
+/// init(), stop() and the window callbacks run rarely enough to stay virtual.
+template <typename Derived>
+class StaticApplication : public Application
+{
+public:
+  void run(Window::Mode mode = Window::Mode::windowed, uint64_t frameCount = 0)
+  {
+    Hooks hooks = { static_cast<Derived &>(*this) };
+    _run(hooks, mode, frameCount);
+  }
+
+private:
+  // qualified calls, hooks overriding the virtual ones aren't dispatched dynamically either
+  struct Hooks
+  {
+    Derived &app;
+
+    void update(float timestep) { app.Derived::update(timestep); }
+    void render() { app.Derived::render(); }
+    void update_ui() { app.Derived::update_ui(); }
+  };
+};
+
+#include "Application.tpp"
@@ -0,0 +1,268 @@
+// template members of Application, included at the end of Application.hpp
+// the loops are instantiated for each kind of hooks: Application's virtual ones, or those of a StaticApplication
+
+template <typename Hooks>
+void Application::_run(Hooks &hooks, Window::Mode mode, uint64_t frameCount)
+{
+  running = true;
+  m_frame = 0;
+  m_frameLimit = frameCount;
+
+  _init(mode);
+  loop(hooks);
+  _stop();
+}
+
+
+template <typename Condition, typename Function, typename Schedule>
+void Application::timed_loop(FramePacer &pacer, Condition conditionChecker, Function function, Schedule schedule)
+{
+  // cap the loop to a minimum interval to ensure a good deltatime acuracy
+  constexpr auto LOOP_TRESHOLD = std::chrono::milliseconds(1);
+
+  loop_clock::time_point now;
+  loop_clock::time_point last = loop_clock::now();
+
+  while (conditionChecker())
+  {
+    loop_clock::time_point deadline = last + LOOP_TRESHOLD;
+    if constexpr (!std::is_null_pointer_v<Schedule>)
+      deadline = std::max(deadline, schedule(last));
+    pacer.waitUntil(deadline);
+
+    now = loop_clock::now();
+    const loop_clock::duration elapsed = now - last;
+
+    const float deltatime = clock_unit(elapsed).count();
+    function(deltatime);
+    last = now;
+  }
+}
+
+template <typename Condition, typename Function>
+void Application::fixed_loop(FramePacer &pacer, Condition conditionChecker, Function function)
+{
+  // upper bound of ticks simulated in one go after a late wake up, the remaining time is dropped
+  // so a slow tick can't snowball into an ever growing backlog
+  constexpr int MAX_CATCHUP_TICKS = 5;
+
+  const loop_clock::duration step = m_tickInterval;
+  const float timestep = clock_unit(step).count();
+
+  // accumulated in clock ticks (nanoseconds) so no precision is lost between ticks
+  loop_clock::duration accumulator = loop_clock::duration::zero();
+  loop_clock::time_point now;
+  loop_clock::time_point last = loop_clock::now();
+
+  m_lastTick = last.time_since_epoch().count();
+
+  while (conditionChecker())
+  {
+    now = loop_clock::now();
+    accumulator = std::min(accumulator + (now - last), step * MAX_CATCHUP_TICKS);
+    last = now;
+
+    while (accumulator >= step)
+    {
+      function(timestep);
+      accumulator -= step;
+      m_lastTick.store((now - accumulator).time_since_epoch().count(), std::memory_order_release);
+    }
+
+    pacer.waitUntil(now + (step - accumulator));
+  }
+}
+
+
+template <typename Hooks>
+void Application::loop(Hooks &hooks)
+{
+  m_updating = false;
+
+  m_updateThread = std::thread([this, &hooks]() { updateLoop(hooks); });
+
+  // sleep until the update thread produced its first state
+  m_updating.wait(false);
+
+  Profiler &profiler = Profiler::get();
+  Profiler::setThreadName("main");
+
+  if (m_useRenderThread)
+  {
+    window.releaseRenderingContext();
+    m_renderThread = std::thread([this, &hooks]() { renderLoop(hooks); });
+
+    // nothing to pace, the main thread sleeps in the event queue until there is an event to handle
+    // or the render thread took the last ui frame and woke it up for the next one
+    constexpr double EVENT_TIMEOUT = 0.1;
+
+    while (running && window.isOpen() && (!m_frameLimit || m_frame < m_frameLimit))
+    {
+      PROFILE_SCOPE("events");
+
+      {
+        PROFILE_SCOPE("window.update");
+        AllocationTracker::Scope phase(AllocationTracker::Phase::events);
+        if (m_uiPending.load(std::memory_order_acquire))
+          window.waitEvents(EVENT_TIMEOUT);
+        else
+          window.update();
+        _forward_backlog();
+      }
+
+      // one ui frame per rendered frame, the render thread redraws the last one until the next arrives
+      if (!m_uiPending.load(std::memory_order_acquire))
+      {
+        AllocationTracker::Scope phase(AllocationTracker::Phase::ui);
+        _update_ui(hooks);
+        _publish_ui();
+      }
+    }
+    running = false;
+
+    m_renderThread.join();
+    window.grabRenderingContext();
+
+    m_updateThread.join();
+    return;
+  }
+
+  timed_loop(m_framePacer,
+    [this]() { return (running && window.isOpen() && (!m_frameLimit || m_frame < m_frameLimit)); },
+    [this, &hooks, &profiler](float deltatime) {
+      profiler.beginFrame();
+      {
+        PROFILE_SCOPE("frame");
+        ++m_frame;
+        window.beginFrame();
+
+        {
+          PROFILE_SCOPE("window.update");
+          AllocationTracker::Scope phase(AllocationTracker::Phase::events);
+          window.update();
+          _process_input(deltatime);
+        }
+
+        shaders.poll();
+        shaderReloader.update();
+
+        _update_ui(hooks);
+        _render(hooks);
+      }
+      profiler.endFrame();
+      AllocationTracker::get().endFrame();
+    },
+    [this](loop_clock::time_point last) { return window.nextFrame(last); }
+  );
+  running = false;
+
+  m_updateThread.join();
+}
+
+template <typename Hooks>
+void Application::updateLoop(Hooks &hooks)
+{
+  Profiler::setThreadName("update");
+
+  const auto condition = [this]() { return !!running; };
+  const auto update = [this, &hooks](float deltatime) {
+    _update(hooks, deltatime);
+
+    if (!m_updating.exchange(true))
+      m_updating.notify_all();
+  };
+
+  if (m_tickInterval == loop_clock::duration::zero())
+    timed_loop(m_updatePacer, condition, update);
+  else
+    fixed_loop(m_updatePacer, condition, update);
+}
+
+/// Owns the GL context while the main thread handles the events and the ui, see setRenderThread().
+template <typename Hooks>
+void Application::renderLoop(Hooks &hooks)
+{
+  Profiler &profiler = Profiler::get();
+  Profiler::setThreadName("render");
+
+  window.grabRenderingContext();
+
+  timed_loop(m_framePacer,
+    [this]() { return (running && (!m_frameLimit || m_frame < m_frameLimit)); },
+    [this, &hooks, &profiler](float deltatime) {
+      profiler.beginFrame();
+      {
+        PROFILE_SCOPE("frame");
+        ++m_frame;
+        window.beginFrame();
+
+        {
+          AllocationTracker::Scope phase(AllocationTracker::Phase::events);
+          _process_events();
+          _process_input(deltatime);
+        }
+
+        shaders.poll();
+        shaderReloader.update();
+
+        if (m_uiFrames.acquire())
+        {
+          m_uiPending.store(false, std::memory_order_release);
+          window.wake();
+        }
+
+        _render(hooks);
+      }
+      profiler.endFrame();
+      AllocationTracker::get().endFrame();
+    },
+    [this](loop_clock::time_point last) { return window.nextFrame(last); }
+  );
+
+  // the main thread may be asleep waiting for the next ui frame request
+  window.wake();
+  window.releaseRenderingContext();
+}
+
+
+template <typename Hooks>
+void Application::_update(Hooks &hooks, float timestep)
+{
+  PROFILE_SCOPE("update");
+  AllocationTracker::Scope phase(AllocationTracker::Phase::update);
+
+  // each of update(), render() and update_ui() gets the scratch of its thread to itself
+  FrameArena::local().reset();
+  hooks.update(timestep);
+}
+
+template <typename Hooks>
+void Application::_render(Hooks &hooks)
+{
+  AllocationTracker::Scope phase(AllocationTracker::Phase::render);
+  FrameArena::local().reset();
+
+  {
+    PROFILE_SCOPE("render");
+    PROFILE_GPU_SCOPE("render");
+
+    _begin_render();
+    hooks.render();
+    _end_render();
+  }
+
+  PROFILE_SCOPE("swap");
+  window.render();
+}
+
+template <typename Hooks>
+void Application::_update_ui(Hooks &hooks)
+{
+  PROFILE_SCOPE("update_ui");
+  AllocationTracker::Scope phase(AllocationTracker::Phase::ui);
+  FrameArena::local().reset();
+
+  _begin_ui();
+  hooks.update_ui();
+  _end_ui();
+}
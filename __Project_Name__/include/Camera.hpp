@@ -1,6 +1,7 @@
 #pragma once
 
-#include "Window.hpp"
+#include "Input.hpp"
+#include "Frustum.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -17,33 +18,53 @@ public:
     orthographic
   };
 
-  glm::vec3 position = { 0, 0, 0 };
-  union
-  {
-    glm::vec2 rotation = { 0, 0 };
-    struct
-    {
-      float yaw;
-      float pitch;
-    };
-  };
-
-public:
   glm::vec3 up() const { return glm::vec3(0, 1, 0); }
 
-  glm::vec3 right() const { return { cos(-yaw), 0, -sin(-yaw) }; }
+  glm::vec3 right() const { return { cos(-m_yaw), 0, -sin(-m_yaw) }; }
 
-  glm::vec3 forward_2d() const { return { -sin(-yaw), 0, -cos(-yaw) }; }
+  glm::vec3 forward_2d() const { return { -sin(-m_yaw), 0, -cos(-m_yaw) }; }
 
   glm::vec3 forward() const
   {
     // Forward vector from spherical coordinates
     // https://en.wikipedia.org/wiki/Spherical_coordinate_system
 
-    const float cosp = cos(-pitch);
-    return { cosp * -sin(-yaw), sin(-pitch), -cosp * cos(-yaw) };
+    const float cosp = cos(-m_pitch);
+    return { cosp * -sin(-m_yaw), sin(-m_pitch), -cosp * cos(-m_yaw) };
+  }
+
+  const glm::vec3 &getPosition() const { return m_position; }
+  float getYaw() const { return m_yaw; }
+  float getPitch() const { return m_pitch; }
+
+  void setPosition(const glm::vec3 &position)
+  {
+    if (position == m_position)
+      return;
+    m_position = position;
+    invalidateView();
+  }
+
+  /// Yaw wraps around, pitch is clamped short of the poles so the view never flips.
+  void setRotation(float yaw, float pitch)
+  {
+    constexpr float TOLLERANCE = 0.00001f;
+    constexpr float HALF_PI = ((float)M_PI_2 - TOLLERANCE);
+    constexpr float TWO_PI = (float)M_PI * 2;
+
+    yaw = glm::mod(yaw, TWO_PI); // ensures no overgrowth
+    pitch = glm::clamp(pitch, -HALF_PI, HALF_PI); // ensures no screen inversion
+
+    if (yaw == m_yaw && pitch == m_pitch)
+      return;
+    m_yaw = yaw;
+    m_pitch = pitch;
+    invalidateView();
   }
 
+  /// Bumped by every change of the view or the projection, consumers compare it to skip unchanged camera data.
+  uint64_t getVersion() const { return m_version; }
+
   ProjType getProjectionType() const { return m_projType; }
 
   void setProjection(ProjType type)
@@ -63,45 +84,52 @@ public:
     rebuildProjectionMatrix();
   }
 
-  glm::mat4 getView() const { return glm::lookAt(position, position + forward(), up()); }
+  // derived matrices are only recomputed when read after a change
+  const glm::mat4 &getView() const { refreshView(); return m_view; }
+  const glm::mat4 &getInverseView() const { refreshView(); return m_inverseView; }
 
-  glm::mat4 getProj() const { return m_proj; }
+  const glm::mat4 &getProj() const { return m_proj; }
+  const glm::mat4 &getInverseProj() const { return m_inverseProj; }
 
-  void update(float timestep, const Window &window)
-  {
-    constexpr float TOLLERANCE = 0.00001f;
-    constexpr float HALF_PI = ((float)M_PI_2 - TOLLERANCE);
-    constexpr float TWO_PI = (float)M_PI * 2;
+  const glm::mat4 &getViewProj() const { refreshViewProj(); return m_viewProj; }
+  const glm::mat4 &getInverseViewProj() const { refreshViewProj(); return m_inverseViewProj; }
 
+  const Frustum &getFrustum() const { refreshViewProj(); return m_frustum; }
+
+  /// Moves and turns the camera from the keys held down in input and the mouse motion since previous.
+  void update(float timestep, const InputState &input, const InputState &previous)
+  {
     float speed = 3.0f;
     float mouseSensivity = 3.0f;
     glm::vec3 movement = { 0, 0, 0 };
 
-    if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL))
+    if (input.down(GLFW_KEY_LEFT_CONTROL))
       speed *= 2.0f;
 
-    if (glfwGetKey(window, GLFW_KEY_W))
+    if (input.down(GLFW_KEY_W))
       movement += forward_2d();
-    if (glfwGetKey(window, GLFW_KEY_S))
+    if (input.down(GLFW_KEY_S))
       movement -= forward_2d();
-    if (glfwGetKey(window, GLFW_KEY_D))
+    if (input.down(GLFW_KEY_D))
       movement += right();
-    if (glfwGetKey(window, GLFW_KEY_A))
+    if (input.down(GLFW_KEY_A))
       movement -= right();
-    if (glfwGetKey(window, GLFW_KEY_SPACE))
+    if (input.down(GLFW_KEY_SPACE))
       movement += up();
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT))
+    if (input.down(GLFW_KEY_LEFT_SHIFT))
       movement -= up();
 
-    glm::dvec2 mouse_delta;
-    glfwGetCursorPos(window, &mouse_delta.x, &mouse_delta.y);
-    glfwSetCursorPos(window, 0, 0);
+    const glm::dvec2 mouse_delta = input.motionSince(previous);
 
-    position += (movement * speed * timestep);
-    rotation += (glm::vec2(mouse_delta) * (mouseSensivity / 1000.0f));
+    // a still camera keeps every cached matrix
+    if (movement != glm::vec3(0, 0, 0))
+      setPosition(m_position + movement * speed * timestep);
 
-    yaw = glm::mod(yaw, TWO_PI); // ensures no overgrowth 
-    pitch = glm::clamp(pitch, -HALF_PI, HALF_PI); // ensures no screen inversion
+    if (mouse_delta != glm::dvec2(0, 0))
+    {
+      const glm::vec2 delta = glm::vec2(mouse_delta) * (mouseSensivity / 1000.0f);
+      setRotation(m_yaw + delta.x, m_pitch + delta.y);
+    }
   }
 
 private:
@@ -112,9 +140,58 @@ private:
       m_proj = glm::perspective(70.0f, ratio, 0.1f, 50.0f);
     else
       m_proj = glm::ortho(0.0f, (float)m_viewport.x, 0.0f, (float)m_viewport.y);
+
+    m_inverseProj = glm::inverse(m_proj);
+    m_viewProjDirty = true;
+    ++m_version;
+  }
+
+  void invalidateView()
+  {
+    m_viewDirty = true;
+    m_viewProjDirty = true;
+    ++m_version;
   }
 
+  void refreshView() const
+  {
+    if (!m_viewDirty)
+      return;
+
+    m_view = glm::lookAt(m_position, m_position + forward(), up());
+    m_inverseView = glm::inverse(m_view);
+    m_viewDirty = false;
+  }
+
+  void refreshViewProj() const
+  {
+    if (!m_viewProjDirty)
+      return;
+
+    refreshView();
+    m_viewProj = m_proj * m_view;
+    m_inverseViewProj = glm::inverse(m_viewProj);
+    m_frustum = Frustum(m_viewProj);
+    m_viewProjDirty = false;
+  }
+
+  glm::vec3 m_position = { 0, 0, 0 };
+  float m_yaw = 0.0f;
+  float m_pitch = 0.0f;
+
   ProjType m_projType = ProjType::perspective;
   glm::ivec2 m_viewport;
   glm::mat4  m_proj;
+  glm::mat4  m_inverseProj;
+
+  uint64_t m_version = 0;
+
+  // caches of the getters, rebuilt on the first read after a change
+  mutable bool m_viewDirty = true;
+  mutable bool m_viewProjDirty = true;
+  mutable glm::mat4 m_view;
+  mutable glm::mat4 m_inverseView;
+  mutable glm::mat4 m_viewProj;
+  mutable glm::mat4 m_inverseViewProj;
+  mutable Frustum m_frustum;
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "JobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// Position based dynamics cloth over a grid of particles.
+/// Particles and constraints are stored as separate component arrays. Constraints are split by
+/// a greedy graph coloring into sets that share no particle, so every set is projected in
+/// parallel over the job system, several constraints per instruction with SSE or AVX.
+/// Every free particle is also tethered to its closest pin, which keeps large grids from stretching
+/// under their own weight at iteration counts low enough for real time.
+class Cloth
+{
+public:
+  struct Settings
+  {
+    glm::vec3 gravity = { 0.0f, -9.81f, 0.0f };
+    glm::vec3 wind = { 0.0f, 0.0f, 0.0f };
+
+    // fraction of the velocity kept per substep
+    float damping = 0.998f;
+
+    // fraction of the error corrected per iteration, structural and shear / bending
+    float stiffness = 1.0f;
+    float bendStiffness = 0.1f;
+
+    uint32_t substeps = 4;
+    uint32_t iterations = 2;
+  };
+
+  /// A width x height grid size units wide, hanging in the XY plane with its top row centered on top.
+  /// The two top corners are pinned.
+  void create(uint32_t width, uint32_t height, float size, const glm::vec3 &top);
+
+  /// Pinned particles have an infinite mass, only moved through setPosition().
+  /// Tethers are measured again from the current shape the next step after pins change.
+  void pin(uint32_t particle, bool pinned = true);
+  void setPosition(uint32_t particle, const glm::vec3 &position);
+
+  void step(float timestep, JobSystem &jobs);
+
+  /// Writes the particle positions interleaved, as the vertex buffer wants them.
+  void positions(glm::vec3 *out) const;
+  /// Two triangles per grid cell, indexing the particles.
+  std::vector<uint32_t> triangles() const;
+
+  uint32_t width() const { return m_width; }
+  uint32_t height() const { return m_height; }
+
+  size_t particles() const { return m_x.size(); }
+  size_t constraints() const { return m_a.size(); }
+  size_t colors() const { return m_colors.size() - 1; }
+
+  Settings settings;
+
+private:
+  // mirrors the particles and constraints on the GPU
+  friend class ClothCompute;
+
+  /// Stiffness per iteration that corrects the same fraction of the error per step whatever the iteration count.
+  static float iterationStiffness(float stiffness, uint32_t iterations);
+
+  void addConstraint(uint32_t a, uint32_t b, bool bend);
+  void color();
+
+  void integrate(uint32_t begin, uint32_t end, const glm::vec3 &displacement);
+  void project(uint32_t begin, uint32_t end, float stiffness, float bendStiffness);
+  void tether(uint32_t begin, uint32_t end);
+  void attach();
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+
+  // particles
+  std::vector<float> m_x, m_y, m_z;
+  std::vector<float> m_px, m_py, m_pz;
+  std::vector<float> m_inverseMass;
+
+  // distance constraints, grouped by color: m_colors[c] to m_colors[c + 1]
+  std::vector<uint32_t> m_a, m_b;
+  std::vector<float> m_rest;
+  std::vector<float> m_bend; // 1 for bending constraints, picks their stiffness without branching
+  std::vector<uint32_t> m_colors = { 0 };
+
+  // closest pin of every particle and the longest they may be apart, rebuilt when pins change
+  std::vector<uint32_t> m_tether;
+  std::vector<float> m_tetherLength;
+  bool m_tethered = false;
+};
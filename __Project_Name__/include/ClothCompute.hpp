@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Cloth.hpp"
+#include "Compute.hpp"
+#include "ShaderLibrary.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+/// The Cloth solver as compute shaders, one dispatch per pass of the CPU solver over the same data.
+/// Positions are updated in place in a buffer that is drawn as vertex data as is, so the simulation
+/// never leaves the GPU. Cloth stays the reference: both run the same algorithm in the same order,
+/// compare() measures how far apart they drifted.
+class ClothCompute
+{
+public:
+  /// Loads the kernels into the library, they are usable once it finished building.
+  /// Instances after the first share the kernels already in the library.
+  void load(ShaderLibrary &shaders);
+
+  /// Copies the particles, constraints and settings of cloth to the GPU. GL thread only, as is everything else.
+  bool create(Cloth &cloth);
+  void destroy();
+
+  bool ready() const;
+
+  void step(float timestep);
+
+  /// Tightly packed vec3 positions, valid as vertex data after a GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT barrier.
+  GLuint positionBuffer() const { return m_positions.id(); }
+
+  /// Reads the positions back, waiting for the GPU.
+  void positions(glm::vec3 *out) const;
+
+  /// Largest distance between a particle here and the same particle of reference.
+  float compare(const Cloth &reference) const;
+
+  size_t particles() const { return m_particles; }
+
+  Cloth::Settings settings;
+
+private:
+  static constexpr GLuint POSITION_BINDING = 0;
+  static constexpr GLuint INVERSE_MASS_BINDING = 1;
+  static constexpr GLuint PREVIOUS_BINDING = 2;
+  static constexpr GLuint CONSTRAINT_BINDING = 3;
+  static constexpr GLuint REST_BINDING = 4;
+  static constexpr GLuint BEND_BINDING = 5;
+  static constexpr GLuint TETHER_BINDING = 6;
+  static constexpr GLuint TETHER_LENGTH_BINDING = 7;
+
+  struct Kernel
+  {
+    // owned by the shader library
+    Shader *shader = nullptr;
+
+    // the work group size of program, queried again only once hot reloading replaced it
+    GLuint program = 0;
+    uint32_t localSize = 1;
+  };
+
+  static Shader &kernel(ShaderLibrary &shaders, const std::string &name, const std::filesystem::path &file);
+  static void dispatch(Kernel &kernel, uint32_t items);
+
+  Kernel m_integrate;
+  Kernel m_project;
+  Kernel m_tether;
+
+  StorageBuffer m_positions;
+  StorageBuffer m_previous;
+  StorageBuffer m_inverseMass;
+  StorageBuffer m_constraints;
+  StorageBuffer m_rest;
+  StorageBuffer m_bend;
+  StorageBuffer m_tethers;
+  StorageBuffer m_tetherLengths;
+
+  std::vector<uint32_t> m_colors;
+  size_t m_particles = 0;
+  bool m_tethered = false;
+};
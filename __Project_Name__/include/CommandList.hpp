@@ -0,0 +1,174 @@
+#pragma once
+
+#include "DrawKey.hpp"
+#include "FrameArena.hpp"
+
+#include <glad/gl.h>
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/// Commands recorded by one thread, replayed later on the GL thread by a CommandQueue.
+/// Commands are plain structs copied into a frame arena that is kept across frames,
+/// so recording never calls GL and stops allocating once the arena has grown to a frame's worth.
+class CommandList
+{
+public:
+  static constexpr uint32_t MAX_BLOCKS = 2;
+
+  /// A uniform block binding pointed at a range of a buffer, unused while size is 0.
+  struct UniformRange
+  {
+    GLuint buffer = 0;
+    GLuint binding = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+  };
+
+  /// Carries all of its state so it can be replayed in any order.
+  struct Draw
+  {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = 0;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for indexed draws
+    GLsizei count = 0;       // vertices, or indices when indexType isn't 0
+    GLuint first = 0;        // first vertex, or first index
+    GLint baseVertex = 0;    // indexed draws only
+    GLsizei instances = 1;
+    UniformRange blocks[MAX_BLOCKS] = {};
+  };
+
+  enum class Type : uint8_t
+  {
+    draw,
+    callback,
+  };
+
+  struct Entry
+  {
+    uint64_t key;
+    Type type;
+    const void *data;
+  };
+
+  CommandList() = default;
+
+  CommandList(const CommandList &) = delete;
+  CommandList &operator=(const CommandList &) = delete;
+
+  /// Replayed in increasing key order, see drawKey().
+  void draw(uint64_t key, const Draw &draw);
+
+  /// Runs function(data) on the GL thread for anything the commands don't cover.
+  /// The state cached by the replay is forgotten afterwards.
+  template <typename T>
+  void callback(uint64_t key, void (*function)(const T &), const T &data)
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "callback data is copied into the arena");
+
+    TypedCallback<T> *command = (TypedCallback<T> *)m_arena.allocate(sizeof(TypedCallback<T>), alignof(TypedCallback<T>));
+    command->invoke = [](const Callback *callback)
+    {
+      const TypedCallback<T> *typed = (const TypedCallback<T> *)callback;
+      typed->function(typed->data);
+    };
+    command->function = function;
+    std::memcpy((void *)&command->data, &data, sizeof(T));
+
+    m_entries.push_back({ key, Type::callback, command });
+  }
+
+  /// The same order as RenderBatch, see DrawKey.
+  static uint64_t drawKey(uint8_t layer, GLuint program, GLuint vertexArray, uint16_t low = 0)
+  {
+    return DrawKey::make(layer, program, vertexArray, low);
+  }
+
+  const std::vector<Entry> &entries() const { return m_entries; }
+
+  /// Forgets the commands, keeps the memory.
+  void clear();
+
+  struct Callback
+  {
+    void (*invoke)(const Callback *callback);
+  };
+
+private:
+  template <typename T>
+  struct TypedCallback : Callback
+  {
+    void (*function)(const T &);
+    T data;
+  };
+
+  // owned by the list rather than the recording thread, the commands outlive the job recording them
+  FrameArena m_arena;
+  std::vector<Entry> m_entries;
+};
+
+/// Command lists recorded in parallel during a frame, merged and replayed on the GL thread.
+/// Every job records into a list of its own, submit() sorts the commands of all of them by key,
+/// skips redundant program, vertex array and uniform block changes, and joins draws of the same
+/// state over contiguous ranges into one.
+class CommandQueue
+{
+public:
+  CommandQueue() = default;
+
+  CommandQueue(const CommandQueue &) = delete;
+  CommandQueue &operator=(const CommandQueue &) = delete;
+
+  /// A list for the calling job to record into, from any thread.
+  /// Among commands with equal keys, lists of lower order are replayed first, then in recording order.
+  CommandList &record(uint32_t order = 0);
+
+  /// Replays and clears everything recorded since the last call, GL thread only.
+  /// Every job recording into the queue must have finished.
+  void submit();
+
+  /// Commands replayed by the last submit(), and the GL draw calls they turned into.
+  uint32_t commands() const { return m_commandCount; }
+  uint32_t drawCalls() const { return m_drawCalls; }
+
+private:
+  struct Recording
+  {
+    std::unique_ptr<CommandList> list;
+    uint32_t order;
+  };
+
+  struct Sorted
+  {
+    uint64_t key;
+    uint32_t order;
+    uint32_t index;
+    const CommandList::Entry *entry;
+  };
+
+  // state left bound by the last replayed command
+  struct State
+  {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    CommandList::UniformRange blocks[16] = {};
+  };
+
+  void issue(const CommandList::Draw &draw, State &state);
+  static bool mergeable(const CommandList::Draw &a, const CommandList::Draw &b);
+
+  std::mutex m_lock;
+  std::vector<Recording> m_recordings;
+  size_t m_recording = 0;
+
+  // GL thread only
+  std::vector<Sorted> m_sorted;
+  uint32_t m_commandCount = 0;
+  uint32_t m_drawCalls = 0;
+};
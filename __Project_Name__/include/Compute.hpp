@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/// Shader storage buffer, read and written by compute shaders.
+/// A storage buffer is a plain GL buffer, so it can be bound as vertex data once the kernels are done with it.
+class StorageBuffer
+{
+public:
+  StorageBuffer() = default;
+  ~StorageBuffer() { destroy(); }
+
+  StorageBuffer(const StorageBuffer &) = delete;
+  StorageBuffer &operator=(const StorageBuffer &) = delete;
+
+  bool create(GLsizeiptr size, const void *data = nullptr, GLenum usage = GL_DYNAMIC_COPY);
+  void destroy();
+
+  void upload(const void *data, GLsizeiptr size, GLintptr offset = 0);
+  /// Waits for every command writing the buffer to finish, keep it out of the frame.
+  void download(void *data, GLsizeiptr size, GLintptr offset = 0) const;
+
+  /// Binds to layout (std430, binding = binding) buffer blocks.
+  void bind(GLuint binding) const;
+  void bind(GLuint binding, GLintptr offset, GLsizeiptr size) const;
+
+  GLuint id() const { return m_buffer; }
+  GLsizeiptr size() const { return m_size; }
+
+private:
+  GLuint m_buffer = 0;
+  GLsizeiptr m_size = 0;
+};
+
+namespace Compute
+{
+  /// Compute shaders and storage buffers need a 4.3 context, or ARB_compute_shader and ARB_shader_storage_buffer_object.
+  bool supported();
+
+  /// The layout (local_size_x, local_size_y, local_size_z) of a linked compute program.
+  /// Queries the program, keep the result for repeated dispatches.
+  glm::uvec3 localSize(const Shader &shader);
+
+  void dispatch(const Shader &shader, const glm::uvec3 &groups);
+  /// One invocation per item along x, rounded up to whole work groups of localSize: kernels check their index against the count.
+  void dispatch(const Shader &shader, uint32_t items, uint32_t localSize);
+
+  /// Makes the writes of the previous dispatches visible to what the barriers name,
+  /// the next dispatches by default, GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT before drawing from the results.
+  void barrier(GLbitfield barriers = GL_SHADER_STORAGE_BARRIER_BIT);
+}
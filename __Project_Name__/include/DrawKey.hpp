@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstdint>
+
+/// Sort key of a draw, RenderBatch and CommandList both order their draws by it.
+/// Layer first, then the most expensive state changes so sorting minimizes them, the low 16 bits are free
+/// (mesh, depth, material...).
+namespace DrawKey
+{
+  constexpr int LAYER_SHIFT = 56;
+  constexpr int PROGRAM_SHIFT = 36;
+  constexpr int VERTEX_ARRAY_SHIFT = 16;
+
+  constexpr uint64_t NAME_MASK = 0xFFFFF;
+
+  constexpr uint64_t make(uint8_t layer, GLuint program, GLuint vertexArray, uint16_t low = 0)
+  {
+    return ((uint64_t)layer << LAYER_SHIFT)
+         | (((uint64_t)program & NAME_MASK) << PROGRAM_SHIFT)
+         | (((uint64_t)vertexArray & NAME_MASK) << VERTEX_ARRAY_SHIFT)
+         | (uint64_t)low;
+  }
+}
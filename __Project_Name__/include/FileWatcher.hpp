@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <filesystem>
+
+/// Reports changes to a set of files from a background thread.
+/// Uses inotify on the parent directories on Linux, so files replaced by a rename are caught too,
+/// and falls back to polling modification times elsewhere. Bursts of events are coalesced.
+class FileWatcher
+{
+public:
+  /// Called on the watcher thread, once per changed file and burst.
+  using Callback = std::function<void(const std::filesystem::path &)>;
+
+  FileWatcher() = default;
+  ~FileWatcher() { stop(); }
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  void start(Callback callback);
+  void stop();
+
+  /// Paths are reported the way they were given here.
+  void watch(const std::filesystem::path &file);
+  void unwatch(const std::filesystem::path &file);
+
+private:
+  struct File
+  {
+    std::filesystem::path path; // as given to watch()
+    std::filesystem::file_time_type modified;
+  };
+
+  static std::filesystem::path key(const std::filesystem::path &file);
+
+  void run();
+  void runInotify();
+  void runPolling();
+
+  Callback m_callback;
+  std::thread m_thread;
+  std::atomic<bool> m_running = false;
+
+  std::mutex m_lock;
+  std::map<std::filesystem::path, File> m_files; // by absolute path
+
+  int m_inotify = -1;
+  std::map<int, std::filesystem::path> m_directories; // inotify watch descriptors
+};
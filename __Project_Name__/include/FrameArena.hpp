@@ -0,0 +1,72 @@
+#pragma once
+
+#include <new>
+#include <span>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+/// Bump allocator for scratch memory that only lives until the end of a frame.
+/// Allocating moves a pointer, reset() forgets everything at once but keeps the memory, and folds the
+/// blocks a busy frame had to add into a single one, so frames no bigger than the largest so far never
+/// touch the heap. Nothing allocated here is ever destroyed, only trivially destructible types fit.
+class FrameArena
+{
+public:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  explicit FrameArena(size_t blockSize = BLOCK_SIZE) : m_blockSize(blockSize) {}
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  /// count value initialized Ts.
+  template <typename T>
+  std::span<T> array(size_t count)
+  {
+    static_assert(std::is_trivially_destructible_v<T>, "frame arena memory is never destroyed");
+
+    T *data = (T *)allocate(sizeof(T) * count, alignof(T));
+    std::uninitialized_value_construct_n(data, count);
+    return { data, count };
+  }
+
+  template <typename T, typename... Args>
+  T *create(Args &&...args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>, "frame arena memory is never destroyed");
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /// Invalidates everything allocated so far.
+  void reset();
+
+  /// Bytes handed out since the last reset, and the most a frame ever needed.
+  size_t used() const { return m_previous + m_used; }
+  size_t peak() const { return m_peak; }
+  size_t capacity() const;
+
+  /// The calling thread's arena. The loop owning the thread resets it at the start of each of its frames:
+  /// every update tick, every rendered frame, and on job threads after every job.
+  static FrameArena &local();
+
+private:
+  struct Block
+  {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+  };
+
+  size_t m_blockSize;
+
+  std::vector<Block> m_blocks;
+  size_t m_block = 0;
+  size_t m_used = 0;     // in the current block
+  size_t m_previous = 0; // in the blocks before it, alignment padding and unused tails included
+  size_t m_peak = 0;
+};
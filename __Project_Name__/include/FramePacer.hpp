@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/// Waits for loop deadlines with a hybrid sleep + spin strategy.
+/// The OS sleep covers most of the wait, and the last stretch - sized from the sleep
+/// overshoot measured so far - is spun on the clock, so deadlines are met to within
+/// a few microseconds instead of a whole scheduler quantum.
+class FramePacer
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Stats
+  {
+    clock::duration lastError;  // how late the last wait returned
+    clock::duration meanError;  // moving average of the error
+    clock::duration maxError;   // worst error since the last reset
+    clock::duration jitter;     // moving average of the deviation from the mean error
+    uint64_t frames;
+  };
+
+  void waitUntil(clock::time_point deadline);
+
+  /// Safe to call from any thread.
+  Stats stats() const;
+  void resetStats();
+
+private:
+  void record(clock::duration error);
+
+  // owned by the waiting thread, in seconds, conservative until the first sleeps are measured
+  double m_overshootMean = 0.0005;
+  double m_overshootDeviation = 0.0;
+
+  std::atomic<clock::rep> m_lastError = 0;
+  std::atomic<clock::rep> m_meanError = 0;
+  std::atomic<clock::rep> m_maxError = 0;
+  std::atomic<clock::rep> m_jitter = 0;
+  std::atomic<uint64_t> m_frames = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/// Bounding spheres stored as separate component arrays so they can be culled several at a time.
+struct BoundingSpheres
+{
+  std::vector<float> x, y, z, radius;
+
+  void push(const glm::vec3 &center, float r)
+  {
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+  }
+
+  void clear() { x.clear(); y.clear(); z.clear(); radius.clear(); }
+  size_t size() const { return x.size(); }
+};
+
+/// Axis aligned boxes stored as separate component arrays so they can be culled several at a time.
+struct BoundingBoxes
+{
+  std::vector<float> minX, minY, minZ;
+  std::vector<float> maxX, maxY, maxZ;
+
+  void push(const glm::vec3 &min, const glm::vec3 &max)
+  {
+    minX.push_back(min.x);
+    minY.push_back(min.y);
+    minZ.push_back(min.z);
+    maxX.push_back(max.x);
+    maxY.push_back(max.y);
+    maxZ.push_back(max.z);
+  }
+
+  void clear() { minX.clear(); minY.clear(); minZ.clear(); maxX.clear(); maxY.clear(); maxZ.clear(); }
+  size_t size() const { return minX.size(); }
+};
+
+/// The six planes of a view-projection, normals pointing inside.
+/// The batch tests run eight volumes per instruction with AVX, four with SSE, one otherwise.
+class Frustum
+{
+public:
+  Frustum() = default;
+  explicit Frustum(const glm::mat4 &viewProjection);
+
+  bool contains(const glm::vec3 &point) const;
+  bool intersects(const glm::vec3 &center, float radius) const;
+  bool intersects(const glm::vec3 &min, const glm::vec3 &max) const;
+
+  /// Writes the indices of the volumes at least partly inside to visible, which needs room for all of them.
+  /// Returns how many were written.
+  size_t cull(const BoundingSpheres &spheres, uint32_t *visible) const;
+  size_t cull(const BoundingBoxes &boxes, uint32_t *visible) const;
+
+  /// Plane i is dot(xyz, point) + w >= 0 inside: left, right, bottom, top, near, far.
+  const std::array<glm::vec4, 6> &planes() const { return m_planes; }
+
+private:
+  std::array<glm::vec4, 6> m_planes = {};
+};
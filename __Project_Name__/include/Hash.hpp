@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+constexpr uint64_t FNV1A_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV1A_PRIME = 1099511628211ull;
+
+/// 64 bit FNV-1a, usable at compile time. Chain calls by passing the previous result as seed.
+constexpr uint64_t fnv1a(std::string_view data, uint64_t seed = FNV1A_OFFSET)
+{
+  for (const char c : data)
+  {
+    seed ^= (uint8_t)c;
+    seed *= FNV1A_PRIME;
+  }
+  return seed;
+}
+
+/// Identifier reduced to its 64 bit hash, string literals are hashed at compile time.
+struct HashedName
+{
+  template <size_t N>
+  consteval HashedName(const char (&name)[N]) : hash(fnv1a(std::string_view(name, N - 1))) {}
+
+  constexpr HashedName(std::string_view name) : hash(fnv1a(name)) {}
+  HashedName(const std::string &name) : hash(fnv1a(name)) {}
+
+  uint64_t hash;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+
+/// Keyboard and mouse as seen at the start of a frame.
+/// Presses, motion and scrolling are running totals: comparing a snapshot to an older one gives everything that
+/// happened in between, however many snapshots the reader skipped.
+struct InputState
+{
+  static constexpr int KEYS = GLFW_KEY_LAST + 1;
+  static constexpr int BUTTONS = GLFW_MOUSE_BUTTON_LAST + 1;
+
+  std::bitset<KEYS> keys;
+  std::bitset<BUTTONS> buttons;
+  std::array<uint32_t, KEYS> keyPresses = {};
+  std::array<uint32_t, BUTTONS> buttonPresses = {};
+  int mods = 0;
+
+  glm::dvec2 cursor = { 0, 0 };
+  glm::dvec2 motion = { 0, 0 };
+  glm::dvec2 scrolled = { 0, 0 };
+
+  // the cursor is hidden and locked to the window, see Input::grab()
+  bool grabbed = false;
+
+  bool down(int key) const { return key >= 0 && key < KEYS && keys[key]; }
+  bool buttonDown(int button) const { return button >= 0 && button < BUTTONS && buttons[button]; }
+
+  bool pressed(int key, const InputState &since) const
+  {
+    return key >= 0 && key < KEYS && keyPresses[key] != since.keyPresses[key];
+  }
+
+  bool clicked(int button, const InputState &since) const
+  {
+    return button >= 0 && button < BUTTONS && buttonPresses[button] != since.buttonPresses[button];
+  }
+
+  glm::dvec2 motionSince(const InputState &since) const { return motion - since.motion; }
+  glm::dvec2 scrollSince(const InputState &since) const { return scrolled - since.scrolled; }
+};
+
+/// Records the GLFW input callbacks into a lock-free ring and turns them into InputState snapshots.
+/// The callbacks only push events, the thread running the frames drains them once per frame and
+/// publishes the result through a triple buffer, so no other thread ever has to call GLFW to know
+/// what is held down, and publishing never allocates.
+class Input
+{
+public:
+  explicit Input(uint32_t capacity = 4096);
+
+  Input(const Input &) = delete;
+  Input &operator=(const Input &) = delete;
+
+  // producer side, the GLFW callbacks on the main thread
+  void key(int key, int action, int mods);
+  void button(int button, int action, int mods);
+  void cursor(double x, double y);
+  void scroll(double x, double y);
+
+  /// The application moved the cursor itself, the jump isn't motion.
+  void warp(double x, double y);
+  /// The cursor was disabled, or given back.
+  void grab(bool grabbed);
+
+  /// Applies the events recorded since the last call and publishes the result when anything changed.
+  /// Once per frame, always from the same thread, the state stays valid until its next call.
+  const InputState &update();
+
+  /// The newest published snapshot, always from the same thread, other than the one calling update().
+  /// Valid until its next call.
+  const InputState &latest();
+
+  /// Events lost to a full ring, a consumer that stalled that long may also miss a release.
+  uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+  struct Event
+  {
+    enum class Type : uint8_t { key, button, cursor, warp, scroll, grab } type;
+
+    int code = 0;
+    int action = 0;
+    int mods = 0;
+    glm::dvec2 value = { 0, 0 };
+  };
+
+  void push(const Event &event);
+  static void apply(InputState &state, const Event &event);
+
+  SpscQueue<Event> m_events;
+
+  // owned by the thread calling update()
+  InputState m_state;
+  TripleBuffer<InputState> m_published;
+
+  std::atomic<uint64_t> m_dropped = 0;
+};
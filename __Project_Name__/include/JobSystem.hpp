@@ -0,0 +1,262 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+
+/// Work-stealing task scheduler.
+/// Every worker owns a deque it pushes to and pops from at the back, idle workers steal
+/// from the front of the others. Threads that aren't workers (the update thread, the main
+/// thread) share one extra queue and help executing jobs while they wait on a result.
+/// Jobs come from a pool and keep small tasks inline, so once the pool and the queues have
+/// grown to a frame's worth of jobs, scheduling no longer touches the heap.
+class JobSystem
+{
+public:
+  struct Job;
+
+  /// Reference counted, the job goes back to the pool with the last handle.
+  /// Handles must not outlive the JobSystem that created them.
+  class Handle
+  {
+  public:
+    Handle() = default;
+    Handle(std::nullptr_t) {}
+    ~Handle() { reset(); }
+
+    Handle(const Handle &other);
+    Handle(Handle &&other) noexcept : m_job(std::exchange(other.m_job, nullptr)) {}
+    Handle &operator=(Handle other) noexcept;
+
+    void reset();
+
+    Job *operator->() const { return m_job; }
+    explicit operator bool() const { return m_job != nullptr; }
+
+  private:
+    friend class JobSystem;
+
+    // adopts a job with one reference already counted
+    explicit Handle(Job *job) : m_job(job) {}
+
+    Job *m_job = nullptr;
+  };
+
+  JobSystem() = default;
+  ~JobSystem() { stop(); }
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  /// 0 workers means one per hardware thread, minus the calling one.
+  void start(uint32_t workerCount = 0);
+  void stop();
+
+  /// Queues task once every dependency has finished.
+  template <typename Task>
+  Handle schedule(Task &&task, std::initializer_list<Handle> dependencies = {});
+  template <typename Task>
+  Handle schedule(Task &&task, const std::vector<Handle> &dependencies);
+
+  /// Splits [0, count) into ranges of at most grain items, 0 picks a grain from the worker count.
+  /// body(begin, end) may run on several threads at once. The returned handle finishes once every
+  /// range has been processed.
+  template <typename Body>
+  Handle parallel_for(uint32_t count, uint32_t grain, Body &&body, std::initializer_list<Handle> dependencies = {});
+
+  /// Blocks until job finished, executing other queued jobs in the meantime.
+  void wait(const Handle &job);
+
+  uint32_t workerCount() const { return (uint32_t)m_workers.size(); }
+
+private:
+  // a ring of jobs, grown by doubling and never shrunk
+  struct alignas(64) Queue
+  {
+    std::mutex lock;
+    std::vector<Handle> jobs;
+    size_t head = 0;
+    size_t count = 0;
+
+    void push_back(Handle job);
+    Handle pop_back();
+    Handle pop_front();
+  };
+
+  // a job waiting on another, linked into the continuations of the latter
+  struct Link
+  {
+    Handle job;
+    Link *next = nullptr;
+  };
+
+  // fixed size nodes, allocated in blocks and reused through the next member
+  template <typename T>
+  struct Pool
+  {
+    static constexpr uint32_t BLOCK_SIZE = 256;
+
+    std::mutex lock;
+    std::vector<std::unique_ptr<T[]>> blocks;
+    T *free = nullptr;
+
+    T *acquire();
+    // returns the chain first to last
+    void release(T *first, T *last);
+  };
+
+  Handle create();
+  void recycle(Job *job);
+  void recycle(Link *links);
+
+  template <typename Task>
+  static void store(Job &job, Task &&task);
+  template <typename Task>
+  Handle scheduleRange(Task &&task, const Handle *begin, const Handle *end);
+
+  void depend(const Handle &job, const Handle &dependency);
+  void release(const Handle &job);
+
+  void push(Handle job);
+  Handle pop(uint32_t queue);
+  Handle steal(uint32_t queue);
+
+  bool executeOne();
+  void execute(const Handle &job);
+  void workerLoop(uint32_t index);
+
+  uint32_t queueIndex() const;
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_workers;
+
+  std::atomic<bool> m_running = false;
+  std::atomic<uint32_t> m_signal = 0;
+
+  Pool<Job> m_jobs;
+  Pool<Link> m_links;
+};
+
+struct JobSystem::Job
+{
+  // tasks up to this size are stored in the job itself, larger ones on the heap
+  static constexpr size_t STORAGE = 48;
+
+  // runs the task, null for jobs that only join others
+  void (*run)(Job &job) = nullptr;
+  // destroys what storage holds, null when empty
+  void (*destroy)(Job &job) = nullptr;
+  alignas(std::max_align_t) std::byte storage[STORAGE];
+
+  // ranges of a parallel_for, the body lives in the storage of the job joining them
+  const Job *owner = nullptr;
+  uint32_t begin = 0;
+  uint32_t end = 0;
+
+  // unfinished dependencies, plus one while the job is being scheduled
+  std::atomic<int32_t> dependencies = 1;
+  std::atomic<bool> finished = false;
+
+  std::mutex lock;
+  Link *continuations = nullptr;
+
+  std::atomic<uint32_t> references = 0;
+  JobSystem *system = nullptr;
+  Job *next = nullptr;
+
+  template <typename Task>
+  const Task &task() const
+  {
+    if constexpr (sizeof(Task) <= STORAGE && alignof(Task) <= alignof(std::max_align_t))
+      return *std::launder((const Task *)storage);
+    else
+      return **std::launder((Task *const *)storage);
+  }
+};
+
+
+template <typename Task>
+void JobSystem::store(Job &job, Task &&task)
+{
+  using Stored = std::decay_t<Task>;
+
+  if constexpr (sizeof(Stored) <= Job::STORAGE && alignof(Stored) <= alignof(std::max_align_t))
+  {
+    new (job.storage) Stored(std::forward<Task>(task));
+    job.destroy = [](Job &job) { std::launder((Stored *)job.storage)->~Stored(); };
+  }
+  else
+  {
+    new (job.storage) Stored *(new Stored(std::forward<Task>(task)));
+    job.destroy = [](Job &job) { delete *std::launder((Stored **)job.storage); };
+  }
+}
+
+template <typename Task>
+JobSystem::Handle JobSystem::scheduleRange(Task &&task, const Handle *begin, const Handle *end)
+{
+  using Stored = std::decay_t<Task>;
+
+  Handle job = create();
+  store(*job.m_job, std::forward<Task>(task));
+  job->run = [](Job &job) { job.task<Stored>()(); };
+
+  for (const Handle *dependency = begin; dependency != end; ++dependency)
+    depend(job, *dependency);
+
+  release(job);
+  return job;
+}
+
+template <typename Task>
+JobSystem::Handle JobSystem::schedule(Task &&task, std::initializer_list<Handle> dependencies)
+{
+  return scheduleRange(std::forward<Task>(task), dependencies.begin(), dependencies.end());
+}
+
+template <typename Task>
+JobSystem::Handle JobSystem::schedule(Task &&task, const std::vector<Handle> &dependencies)
+{
+  return scheduleRange(std::forward<Task>(task), dependencies.data(), dependencies.data() + dependencies.size());
+}
+
+template <typename Body>
+JobSystem::Handle JobSystem::parallel_for(uint32_t count, uint32_t grain, Body &&body, std::initializer_list<Handle> dependencies)
+{
+  using Stored = std::decay_t<Body>;
+
+  // a few ranges per thread lets stealing even out uneven ranges
+  if (grain == 0)
+    grain = std::max(1u, count / ((workerCount() + 1) * 4));
+
+  // finishes once every range did, and keeps the body alive until then
+  Handle done = create();
+  store(*done.m_job, std::forward<Body>(body));
+
+  for (uint32_t begin = 0; begin < count; begin += grain)
+  {
+    Handle range = create();
+    range->owner = done.m_job;
+    range->begin = begin;
+    range->end = std::min(count, begin + grain);
+    range->run = [](Job &job) { job.owner->task<Stored>()(job.begin, job.end); };
+
+    for (const Handle &dependency : dependencies)
+      depend(range, dependency);
+
+    depend(done, range);
+    release(range);
+  }
+
+  release(done);
+  return done;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "SpscQueue.hpp"
+
+#include <glad/gl.h>
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+/// Times the enclosing scope on the calling thread.
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILER_CONCAT(_profile_scope_, __LINE__)(name)
+
+/// Times the GL commands issued in the enclosing scope, render thread only.
+#define PROFILE_GPU_SCOPE(name) Profiler::GpuScope PROFILER_CONCAT(_profile_gpu_scope_, __LINE__)(name)
+
+/// Frame profiler with scoped CPU zones and GL timer queries.
+/// Every thread records its zones into its own lock-free ring buffer, the render thread
+/// collects them once per frame to feed the ImGui panel and the Chrome trace export.
+class Profiler
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct Zone
+  {
+    const char *name;
+    clock::rep begin;
+    clock::rep end;
+    uint32_t thread;
+    uint32_t depth;
+  };
+
+  class Scope
+  {
+  public:
+    explicit Scope(const char *name) : m_name(name), m_depth(Profiler::enter()), m_begin(clock::now()) {}
+    ~Scope() { Profiler::leave(m_name, m_depth, m_begin, clock::now()); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    const char *m_name;
+    uint32_t m_depth;
+    clock::time_point m_begin;
+  };
+
+  class GpuScope
+  {
+  public:
+    explicit GpuScope(const char *name) { Profiler::get().beginGpu(name); }
+    ~GpuScope() { Profiler::get().endGpu(); }
+
+    GpuScope(const GpuScope &) = delete;
+    GpuScope &operator=(const GpuScope &) = delete;
+  };
+
+  static Profiler &get();
+
+  /// Names the calling thread in the panel, in exported traces and in the allocation panel.
+  static void setThreadName(const std::string &name);
+
+  /// Frame boundaries, called by the main loop on the GL thread.
+  void beginFrame();
+  void endFrame();
+
+  void beginGpu(const char *name);
+  void endGpu();
+
+  /// Releases the GL queries, must run while the context is still alive.
+  void shutdown();
+
+  void drawUi(bool *open = nullptr);
+  bool exportChromeTrace(const std::filesystem::path &path) const;
+
+private:
+  static constexpr uint32_t GPU_THREAD = UINT32_MAX;
+  static constexpr uint32_t ZONES_PER_THREAD = 1 << 14;
+  static constexpr uint32_t HISTORY = 512;   // frames kept for the panel and the export
+  static constexpr uint32_t GPU_LATENCY = 4; // frames before timer queries are read back
+
+  struct ThreadData
+  {
+    explicit ThreadData(uint32_t id) : id(id), zones(ZONES_PER_THREAD) {}
+
+    uint32_t id;
+    uint32_t depth = 0;
+    std::string name;
+    SpscQueue<Zone> zones;
+    std::atomic<uint32_t> dropped = 0;
+  };
+
+  struct Frame
+  {
+    clock::rep begin = 0;
+    clock::rep end = 0;
+    uint64_t firstZone = 0; // absolute index of the first zone collected during this frame
+  };
+
+  struct GpuZone
+  {
+    const char *name;
+    uint32_t depth;
+  };
+
+  struct GpuFrame
+  {
+    std::vector<GLuint> queries; // begin/end timestamp pairs, reused every GPU_LATENCY frames
+    std::vector<GpuZone> zones;
+    std::vector<uint32_t> open;
+    int64_t offset = 0;          // cpu clock minus gpu clock when the frame started
+  };
+
+  Profiler() = default;
+
+  static ThreadData &local();
+  static uint32_t enter();
+  static void leave(const char *name, uint32_t depth, clock::time_point begin, clock::time_point end);
+
+  void collect();
+  void collectGpu(GpuFrame &frame);
+  void trim();
+
+  void drawFlameGraph(const Frame &frame);
+  void drawHistograms();
+  void drawPhases(const Frame &frame);
+
+  const Frame &frame(uint64_t index) const { return m_frames[index % HISTORY]; }
+  Frame &frame(uint64_t index) { return m_frames[index % HISTORY]; }
+
+  // taken on thread registration and by the collecting thread, never on the recording path
+  mutable std::mutex m_threadsLock;
+  std::vector<std::unique_ptr<ThreadData>> m_threads;
+
+  // frame history, written by the render thread and read by whichever thread draws the ui.
+  // taken before m_threadsLock when both are needed
+  mutable std::mutex m_historyLock;
+  bool m_paused = false;
+  uint64_t m_frameIndex = 0;
+  std::array<Frame, HISTORY> m_frames;
+  std::deque<Zone> m_zones;
+  uint64_t m_zonesTrimmed = 0;
+
+  // render thread only
+  bool m_recording = false;
+  std::array<GpuFrame, GPU_LATENCY> m_gpuFrames;
+};
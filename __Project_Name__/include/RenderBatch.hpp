@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "DrawKey.hpp"
+#include "StreamingBuffer.hpp"
+
+#include <glm/glm.hpp>
+#include <glad/gl.h>
+
+#include <vector>
+#include <cstdint>
+
+/// Gathers the draws of a frame and turns every run of identical shader and mesh into one instanced draw.
+/// Draws are sorted by a 64 bit state key, their instance data streamed in that order, and each
+/// group of meshes sharing a vertex array is issued with a single glMulti*Indirect call when available,
+/// with one glDraw*Instanced per mesh otherwise.
+class RenderBatch
+{
+public:
+  /// Per-instance attributes, read by the vertex shader at MODEL_LOCATION (4 columns) and TINT_LOCATION.
+  struct Instance
+  {
+    glm::mat4 model;
+    glm::vec4 tint = { 1.0f, 1.0f, 1.0f, 1.0f };
+  };
+
+  static constexpr GLuint MODEL_LOCATION = 2;
+  static constexpr GLuint TINT_LOCATION = 6;
+
+  /// A range of a vertex array. Meshes sharing a vertex array are merged into one indirect draw.
+  struct Mesh
+  {
+    GLuint vertexArray = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;       // vertices, or indices when indexType isn't 0
+    GLuint first = 0;        // first vertex, or first index
+    GLint baseVertex = 0;    // indexed meshes only
+    GLenum indexType = 0;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT for indexed meshes
+  };
+
+  RenderBatch() = default;
+  ~RenderBatch() { destroy(); }
+
+  RenderBatch(const RenderBatch &) = delete;
+  RenderBatch &operator=(const RenderBatch &) = delete;
+
+  /// maxInstances is the most instances drawn in one frame, the rest is dropped.
+  bool create(uint32_t maxInstances);
+  void destroy();
+
+  /// Enables the instance attributes on the mesh's vertex array, returns the id to submit it with.
+  uint32_t addMesh(const Mesh &mesh);
+
+  /// Layers are drawn in increasing order, draws of a layer are ordered by shader then mesh.
+  void submit(const Shader &shader, uint32_t mesh, const Instance &instance, uint8_t layer = 0);
+
+  /// Sorts and issues everything submitted since the last flush, at most once per frame.
+  void flush();
+
+  /// Draw calls issued by the last flush, and the instances they drew.
+  uint32_t drawCalls() const { return m_drawCalls; }
+  uint32_t instances() const { return m_instanceCount; }
+
+private:
+  struct Draw
+  {
+    uint64_t key; // layer | program | vertex array | mesh
+    GLuint program;
+    uint32_t mesh;
+    uint32_t instance;
+  };
+
+  // consecutive draws of the same program and mesh, one instanced draw
+  struct Run
+  {
+    GLuint program;
+    uint32_t mesh;
+    uint32_t firstInstance; // in the sorted instance stream
+    uint32_t instanceCount;
+  };
+
+  // consecutive runs of one program over meshes sharing a vertex array, one indirect draw
+  struct Group
+  {
+    uint32_t firstRun;
+    uint32_t runCount;
+  };
+
+  // same layout for both indirect commands, arrays ones leave the last field unused
+  struct IndirectCommand
+  {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLint baseVertex;   // baseInstance for arrays
+    GLuint baseInstance;
+  };
+
+  void pointInstances(GLintptr offset) const;
+  void drawRun(const Run &run, GLintptr instances) const;
+
+  uint32_t m_capacity = 0;
+  bool m_indirect = false;
+
+  StreamingBuffer m_instanceStream;
+  StreamingBuffer m_commandStream;
+
+  std::vector<Mesh> m_meshes;
+  std::vector<Instance> m_instances;
+  std::vector<Draw> m_draws;
+  std::vector<Run> m_runs;
+  std::vector<Group> m_groups;
+
+  uint32_t m_drawCalls = 0;
+  uint32_t m_instanceCount = 0;
+  bool m_warned = false;
+};
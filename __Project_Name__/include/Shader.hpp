@@ -1,12 +1,16 @@
 #pragma once
 
+#include "Hash.hpp"
 
 #include <glad/gl.h>
 
 #include <map>
 #include <string>
+#include <vector>
 #include <filesystem>
 
+class JobSystem;
+
 class Shader
 {
 public:
@@ -26,41 +30,173 @@ public:
 
   Shader &operator=(Shader &&other) noexcept;
 
+  /// Macros injected after the #version line of every stage, as name and value.
+  using Defines = std::vector<std::pair<std::string, std::string>>;
+
+  /// Sources are only compiled by compile(), which reports their errors.
+  /// The current program stays in use until a build replaces it.
   bool addSource(Type type, const std::vector<std::string_view> &source);
   bool addSource(Type shaderType, const std::string_view &source);
   bool addFile(Type shaderType, const std::filesystem::path &filePath);
   void remove(Type type);
   void clear();
 
+  /// Loads the program from the binary cache when possible, compiles and links the sources otherwise.
+  /// A failed build keeps the previous program.
   bool compile();
 
+  /// Same as compile() without waiting for the driver, poll() swaps the new program in once it is linked.
+  /// With GL_KHR_parallel_shader_compile the build runs on driver threads and never blocks the caller.
+  bool compileAsync();
+  /// What a build needs from the disk, gathered by prepare().
+  struct Prepared
+  {
+    std::map<Type, std::string> sources; // as read, kept by the shader for later builds
+    std::map<Type, std::string> code;    // the sources preprocessed
+    std::vector<std::filesystem::path> includes;
+
+    // binary cache entry of code, left empty until a build told which driver it is for
+    uint64_t key = 0;
+    GLenum format = 0;
+    std::vector<char> binary;
+  };
+
+  /// Reads and preprocesses the files, then looks them up in the binary cache.
+  /// Makes no GL call, so a thread without the context can take the disk accesses off the GL thread.
+  static bool prepare(const std::map<Type, std::filesystem::path> &files, const Defines &defines, Prepared &prepared);
+  /// compileAsync() from what prepare() gathered, nothing is read from the disk.
+  bool compileAsync(Prepared &&prepared);
+
+  /// Returns true when a pending build has just replaced the program.
+  bool poll();
+  bool building() const { return m_building != 0; }
+
+  /// Files given to addFile(), the sources hot reloading re-reads.
+  const std::map<Type, std::filesystem::path> &files() const { return m_files; }
+  /// Every file the last build pulled in through #include.
+  const std::vector<std::filesystem::path> &includes() const { return m_includes; }
+  static bool readFile(const std::filesystem::path &filePath, std::string &source);
+
+  /// Selects the permutation built by the next compile.
+  void setDefines(const Defines &defines);
+  const Defines &defines() const { return m_defines; }
+
+  /// Unbuilt copy of the sources with another set of defines, sharing the block bindings.
+  Shader permute(const Defines &defines) const;
+  /// Identifies a set of defines regardless of their order.
+  static uint64_t permutationHash(const Defines &defines, uint64_t seed = FNV1A_OFFSET);
+
+  /// Resolves #include "file" relative to origin, then to every include directory, and injects the defines.
+  /// Included files are read once and kept in memory, an included file is only expanded once per source.
+  static bool preprocess(std::string_view source, const std::filesystem::path &origin, const Defines &defines,
+                         std::string &result, std::vector<std::filesystem::path> &includes);
+  static void addIncludeDirectory(const std::filesystem::path &directory);
+  /// Re-reads an included file into the in-memory cache.
+  static void reloadInclude(const std::filesystem::path &file);
+
   GLuint id();
   GLuint id() const;
 
   bool valid() const { return m_valid; }
 
-  GLint getUniform(const std::string &name) const;
-  GLint getAttribute(const std::string &name) const;
+  /// Single probe in a flat table, no allocation: getUniform("MVP") hashes the literal at compile time.
+  GLint getUniform(HashedName name) const { return m_uniforms.find(name.hash); }
+  GLint getAttribute(HashedName name) const { return m_attributes.find(name.hash); }
+
+  /// Uniform block reflection, members of every block are looked up by name through getBlockOffset().
+  GLuint getBlockIndex(HashedName block) const;
+  GLint getBlockSize(HashedName block) const;
+  GLint getBlockOffset(HashedName member) const { return m_offsets.find(member.hash); }
+
+  /// Points a uniform block at a buffer binding, reapplied whenever the program is relinked.
+  void setBlockBinding(HashedName block, GLuint binding);
 
   static const Shader &getDefaultShader();
   static Type typeFromString(const std::string_view name);
 
+  /// Where linked program binaries are cached between runs, an empty path disables the cache.
+  static void setCacheDirectory(const std::filesystem::path &directory);
+  /// Binaries are written to the cache from jobs when set, by the thread linking the programs otherwise.
+  static void setCacheWriter(JobSystem *jobs);
+
 private:
+  /// Open addressing hash table from name hashes to locations, kept at most half full.
+  class LocationTable
+  {
+  public:
+    void build(const std::vector<std::pair<std::string, GLint>> &entries);
+    void clear() { m_slots.clear(); }
+
+    GLint find(uint64_t hash) const
+    {
+      if (m_slots.empty())
+        return -1;
+
+      for (size_t i = hash & m_mask;; i = (i + 1) & m_mask)
+      {
+        if (m_slots[i].hash == hash)
+          return m_slots[i].location;
+        if (m_slots[i].hash == EMPTY)
+          return -1;
+      }
+    }
+
+  private:
+    static constexpr uint64_t EMPTY = 0;
+
+    struct Slot
+    {
+      uint64_t hash = EMPTY;
+      GLint location = -1;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_mask = 0;
+  };
+
   static GLenum typeToGl(Type type);
 
   static Shader default_shader;
+  static std::filesystem::path cache_directory;
+  static JobSystem *cache_writer;
+  static std::vector<std::filesystem::path> include_directories;
 
   void scanUniforms();
   void scanAttributes();
-  void getProgramErrors();
+  void scanBlocks();
+  void getProgramErrors(GLuint program);
   void getShaderErrors(GLuint shaderId);
   GLuint getOrCreate(Type shaderType);
 
+  bool startBuild();
+  bool submitBuild(const Prepared &prepared);
+  bool finishBuild();
+
+  static uint64_t cacheKey(const std::map<Type, std::string> &code, uint64_t driver);
+  static bool readBinary(uint64_t key, GLenum &format, std::vector<char> &binary);
+  static bool loadBinary(GLuint program, const Prepared &prepared);
+  static void saveBinary(GLuint program, uint64_t key);
+  static void writeBinary(uint64_t key, GLenum format, const std::vector<char> &binary);
+
   bool m_valid = false;
   GLuint m_program = 0;
+
+  // program being built, swapped in by finishBuild()
+  GLuint m_building = 0;
+  uint64_t m_buildKey = 0;
+  bool m_buildCached = false;
+
+  std::map<Type, std::string> m_sources;
+  std::map<Type, std::filesystem::path> m_files;
+  std::vector<std::filesystem::path> m_includes;
+  Defines m_defines;
   std::map<Type, GLuint> m_shaders;
-  std::map<std::string, GLint> m_uniforms;
-  std::map<std::string, GLint> m_attributes;
+  LocationTable m_uniforms;
+  LocationTable m_attributes;
+  LocationTable m_blocks;
+  LocationTable m_offsets;
+  std::vector<GLint> m_blockSizes;
+  std::vector<std::pair<uint64_t, GLuint>> m_blockBindings;
 };
 
 static inline bool operator!(Shader::Type a)
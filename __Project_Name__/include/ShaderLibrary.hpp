@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Hash.hpp"
+#include "Shader.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include <unordered_map>
+#include <initializer_list>
+
+class ShaderReloader;
+
+/// Named shader programs, built together.
+/// Every program is submitted as soon as it is loaded and no status is queried before wait(),
+/// so the driver can compile them all at once (on its own threads with GL_KHR_parallel_shader_compile)
+/// and startup costs about as much as the slowest program instead of the sum of all of them.
+class ShaderLibrary
+{
+public:
+  struct Stage
+  {
+    Shader::Type type;
+    std::filesystem::path file;
+  };
+
+  /// Reads the stages and starts building them, the program is usable once wait() returned.
+  /// Loading an existing name rebuilds it in place, references to it stay valid.
+  Shader &load(const std::string &name, std::initializer_list<Stage> stages);
+
+  /// nullptr when no program was loaded under that name.
+  Shader *get(HashedName name) const;
+
+  /// The named program built with another set of defines, nullptr for unknown names.
+  /// Each permutation is built once from the sources already in memory, later calls return it whatever the order of the defines.
+  Shader *variant(const std::string &name, const Shader::Defines &defines);
+
+  /// Polls every pending build without blocking, returns true once none is left.
+  bool poll();
+  /// Blocks until every build finished, returns how many of them failed.
+  size_t wait();
+
+  /// Registers every program with reloader, then those loaded or permuted later on as they are created.
+  /// nullptr, or clear(), unregisters them.
+  void watch(ShaderReloader *reloader);
+
+  void forEach(const std::function<void(const std::string &, Shader &)> &function) const;
+  size_t size() const { return m_programs.size(); }
+
+  void clear();
+
+private:
+  struct Program
+  {
+    std::string name;
+    std::unique_ptr<Shader> shader;
+  };
+
+  std::unordered_map<uint64_t, Program> m_programs;
+  std::vector<Shader *> m_pending;
+  size_t m_failed = 0;
+
+  ShaderReloader *m_reloader = nullptr;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Shader.hpp"
+#include "FileWatcher.hpp"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+/// Rebuilds shaders whenever one of their source files changes on disk.
+/// Files are re-read, preprocessed and looked up in the binary cache on the watcher thread, the GL thread
+/// only submits the expanded sources and swaps each program in once the driver is done with it,
+/// a failed build keeps the old one.
+class ShaderReloader
+{
+public:
+  ~ShaderReloader() { stop(); }
+
+  void start();
+  void stop();
+
+  /// Watches the files the shader was given through addFile().
+  void add(Shader &shader);
+  void remove(Shader &shader);
+
+  /// Submits the reloaded sources and swaps in finished programs, GL thread only.
+  void update();
+
+  /// Rebuilds swapped in and rebuilds that failed since the reloader was created, safe from any thread.
+  size_t reloaded() const { return m_reloaded.load(std::memory_order_relaxed); }
+  size_t failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+private:
+  struct Entry
+  {
+    Shader *shader;
+    std::map<Shader::Type, std::filesystem::path> files;
+    std::vector<std::filesystem::path> includes;
+    Shader::Defines defines;
+  };
+
+  struct Reload
+  {
+    Shader *shader;
+    Shader::Prepared prepared;
+  };
+
+  void onChange(const std::filesystem::path &file);
+
+  FileWatcher m_watcher;
+
+  // shared with the watcher thread
+  std::mutex m_lock;
+  std::vector<Entry> m_entries;
+  std::vector<Reload> m_reloads;
+
+  // GL thread only
+  std::vector<Shader *> m_building;
+
+  std::atomic<size_t> m_reloaded = 0;
+  std::atomic<size_t> m_failed = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/// Bounded lock-free single producer / single consumer ring buffer.
+/// push() must only be called from one thread and pop() from one (possibly other) thread.
+template <typename T>
+class SpscQueue
+{
+public:
+  /// The capacity is rounded up to a power of two.
+  explicit SpscQueue(uint32_t capacity)
+  {
+    uint32_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+
+    m_items = std::make_unique<T[]>(size);
+    m_mask = size - 1;
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  /// Returns false, dropping the value, when the queue is full.
+  bool push(const T &value)
+  {
+    const uint32_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+      return false;
+
+    m_items[head & m_mask] = value;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &value)
+  {
+    const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+      return false;
+
+    value = m_items[tail & m_mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire); }
+  uint32_t capacity() const { return m_mask + 1; }
+
+private:
+  std::unique_ptr<T[]> m_items;
+  uint32_t m_mask;
+
+  // written by the producer and the consumer respectively, kept on separate cache lines
+  alignas(64) std::atomic<uint32_t> m_head = 0;
+  alignas(64) std::atomic<uint32_t> m_tail = 0;
+};
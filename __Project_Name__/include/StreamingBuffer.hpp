@@ -0,0 +1,77 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/// Ring of data rewritten every frame, such as dynamic vertices or uniform blocks.
+/// Each frame in flight owns a region of the buffer guarded by a fence, so writing never
+/// overwrites data the GPU may still read and never waits on a driver reallocation.
+/// The buffer stays mapped when glBufferStorage is available and allocations point straight
+/// into GPU-visible memory, otherwise they are staged and uploaded with one glBufferSubData per flush().
+class StreamingBuffer
+{
+public:
+  static constexpr uint32_t FRAMES = 3;
+
+  struct Allocation
+  {
+    void *data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+
+    explicit operator bool() const { return data != nullptr; }
+  };
+
+  StreamingBuffer() = default;
+  ~StreamingBuffer() { destroy(); }
+
+  StreamingBuffer(const StreamingBuffer &) = delete;
+  StreamingBuffer &operator=(const StreamingBuffer &) = delete;
+
+  /// frameSize is the most data written during one frame, every allocation starts at a multiple of alignment.
+  bool create(GLsizeiptr frameSize, GLsizeiptr alignment = 1);
+  void destroy();
+
+  /// Waits for the GPU to release the region last used FRAMES frames ago.
+  void beginFrame();
+  /// Flushes what is left and fences the region of the frame.
+  void endFrame();
+
+  /// Returns an empty allocation once the frame region is full.
+  Allocation allocate(GLsizeiptr size);
+
+  template <typename T>
+  Allocation push(const T &value)
+  {
+    Allocation allocation = allocate(sizeof(T));
+    if (allocation)
+      std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation;
+  }
+
+  /// Makes everything written so far visible to the draws issued after it.
+  /// Write the data of a whole batch first: without persistent mapping every flush is an upload.
+  void flush();
+
+  GLuint id() const { return m_buffer; }
+  bool persistent() const { return m_mapped != nullptr; }
+
+private:
+  GLintptr regionBegin() const { return m_frameSize * m_frame; }
+
+  GLuint m_buffer = 0;
+  GLsizeiptr m_frameSize = 0;
+  GLsizeiptr m_alignment = 1;
+
+  uint8_t *m_mapped = nullptr;    // the whole buffer while persistently mapped
+  std::vector<uint8_t> m_staging; // the current region otherwise
+
+  uint32_t m_frame = 0;
+  GLsizeiptr m_cursor = 0;
+  GLsizeiptr m_flushed = 0;
+  std::array<GLsync, FRAMES> m_fences = {};
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/// Single producer / single consumer triple buffer.
+/// The producer fills back() and publish()es it, the consumer acquire()s the newest
+/// published state and reads it through front(). Both sides only ever touch their own
+/// slot and exchange it with the shared one in a single atomic operation, so neither
+/// thread can block, or tear a frame of, the other.
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T &initial) : m_slots{ initial, initial, initial } {}
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // producer side
+  T &back() { return m_slots[m_back]; }
+
+  void publish()
+  {
+    const uint8_t previous = m_middle.exchange(m_back | DIRTY, std::memory_order_acq_rel);
+    m_back = previous & INDEX;
+  }
+
+  // consumer side
+  bool acquire()
+  {
+    if (!(m_middle.load(std::memory_order_relaxed) & DIRTY))
+      return false;
+
+    const uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front = previous & INDEX;
+    return true;
+  }
+
+  T &front() { return m_slots[m_front]; }
+  const T &front() const { return m_slots[m_front]; }
+
+private:
+  static constexpr uint8_t INDEX = 0b011;
+  static constexpr uint8_t DIRTY = 0b100;
+
+  T m_slots[3];
+
+  // each side gets its own cache line so publishing never invalidates the reader's index
+  alignas(64) std::atomic<uint8_t> m_middle = 1;
+  alignas(64) uint8_t m_back = 0;
+  alignas(64) uint8_t m_front = 2;
+};
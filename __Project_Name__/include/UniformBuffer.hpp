@@ -0,0 +1,22 @@
+#pragma once
+
+#include "StreamingBuffer.hpp"
+
+/// Per-frame uniform blocks for every draw, staged into one streaming buffer and bound by offset.
+class UniformBuffer : public StreamingBuffer
+{
+public:
+  bool create(GLsizeiptr frameSize)
+  {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    return StreamingBuffer::create(frameSize, alignment);
+  }
+
+  /// Points a uniform block binding at an allocation.
+  void bind(GLuint binding, const Allocation &allocation) const
+  {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, id(), allocation.offset, allocation.size);
+  }
+};
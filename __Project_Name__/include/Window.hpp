@@ -1,9 +1,16 @@
 #pragma once
 
+#include "Input.hpp"
+
 #include <glm/glm.hpp>
 #include <GLFW/glfw3.h>
 
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdint>
 #include <string_view>
 
 class Application;
@@ -11,28 +18,113 @@ class Application;
 class Window
 {
 public:
+  enum class Mode : uint8_t
+  {
+    windowed,
+    headless, // hidden window rendering into an offscreen framebuffer, works without a display
+  };
+
+  enum class Pacing : uint8_t
+  {
+    vsync,      // swaps wait for the vertical blank
+    uncapped,   // frames are presented as soon as they are rendered, tearing included
+    target,     // uncapped swaps, frames started at a fixed rate
+    lowLatency, // vsync, each frame started as late as its measured render time allows
+  };
+
+  using clock = std::chrono::steady_clock;
+
+  /// Time from the start of a frame, where input is read, to its swap returning.
+  struct Latency
+  {
+    clock::duration last;
+    clock::duration mean;
+    clock::duration max;
+    clock::duration render; // moving average of the start of a frame to its commands being done
+    uint64_t frames;
+  };
+
   Window(Application &app) noexcept;
   Window(Window &&mv) noexcept;
   ~Window() noexcept;
 
   operator GLFWwindow *() const;
 
-  bool create(const std::string_view title, int width, int height);
+  bool create(const std::string_view title, int width, int height, Mode mode = Mode::windowed);
   void update();
+  /// Sleeps until an event arrives, wake() is called, or timeout seconds passed, then handles the events. Main thread only.
+  void waitEvents(double timeout);
+  /// Wakes waitEvents() up, from any thread.
+  void wake();
   void render();
   void clear();
   void close();
   void setVSync(bool enabled);
 
+  /// Safe to call from any thread, the swap interval changes with the next render().
+  /// targetFps is only used by Pacing::target, 0 keeps the previous one.
+  void setPacing(Pacing pacing, double targetFps = 0.0);
+  Pacing pacing() const { return m_pacing.load(std::memory_order_relaxed); }
+  double targetFps() const { return m_targetFps.load(std::memory_order_relaxed); }
+
+  /// Refresh rate of the monitor the window is on, main thread only.
+  double refreshRate() const;
+
+  /// Marks the start of a frame, before its input is read. Thread rendering only, as is nextFrame().
+  void beginFrame();
+  /// When the frame after the one that started at lastStart should start.
+  clock::time_point nextFrame(clock::time_point lastStart) const;
+
+  /// Safe to call from any thread.
+  Latency latency() const;
+
   bool isOpen() const;
+  bool isHeadless() const { return m_mode == Mode::headless; }
+
+  glm::ivec2 size() const { return m_size; }
+
+  /// Copies the current frame as tightly packed, bottom-up RGBA8 rows.
+  bool readPixels(std::vector<uint8_t> &pixels) const;
 
   void grabRenderingContext();
   void releaseRenderingContext();
 
+  /// Every key, button, cursor and scroll callback lands here before the application's handlers run.
+  Input &input() const { return *m_input; }
+
 
 private:
   void initEventCallbacks();
+  bool createFramebuffer();
+  void recordFrame(clock::time_point rendered, clock::time_point presented);
 
   Application &m_app;
   GLFWwindow *m_handle = nullptr;
+  std::unique_ptr<Input> m_input;
+
+  Mode m_mode = Mode::windowed;
+  glm::ivec2 m_size = { 0, 0 };
+
+  // headless render target
+  uint32_t m_framebuffer = 0;
+  uint32_t m_colorbuffer = 0;
+  uint32_t m_depthbuffer = 0;
+
+  // pacing, written by any thread
+  std::atomic<Pacing> m_pacing = Pacing::vsync;
+  std::atomic<double> m_targetFps = 60.0;
+  std::atomic<double> m_refreshInterval = 1.0 / 60.0; // in seconds
+
+  // owned by the thread rendering
+  int m_swapInterval = -1;
+  clock::time_point m_frameStart;
+  clock::time_point m_presented;
+  double m_renderMean = 0.0; // in seconds
+  double m_renderDeviation = 0.0;
+
+  std::atomic<clock::rep> m_lastLatency = 0;
+  std::atomic<clock::rep> m_meanLatency = 0;
+  std::atomic<clock::rep> m_maxLatency = 0;
+  std::atomic<clock::rep> m_meanRender = 0;
+  std::atomic<uint64_t> m_frames = 0;
 };
\ No newline at end of file
@@ -19,6 +19,7 @@ project "__Project_Name__"
 
     "include/**.h",
     "include/**.hpp",
+    "include/**.tpp",
 
     "source/**.h",
     "source/**.c",
@@ -45,8 +46,12 @@ project "__Project_Name__"
     "imgui",
   }
 
+  filter "options:track-allocations"
+    defines "TRACK_ALLOCATIONS"
+
   filter "system:linux"
     pic "On"
+    links { "dl", "pthread" }
   
   filter "system:macosx"
     pic "On"
@@ -59,3 +64,4 @@ project "__Project_Name__"
     defines "NDEBUG"
     runtime "Release"
     optimize "On"
+    flags { "LinkTimeOptimization" }
@@ -1,14 +1,21 @@
 #version 330 core
 
-uniform mat4 MVP;
+layout (std140) uniform Frame
+{
+  mat4 viewProjection;
+};
 
 layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec3 vCol;
 
+// per instance, streamed by the render batch
+layout (location = 2) in mat4 model;
+layout (location = 6) in vec4 tint;
+
 out vec3 color;
 
 void main()
 {
-  color = vCol;
-  gl_Position = MVP * vec4(vPos, 1.0);
+  color = vCol * tint.rgb;
+  gl_Position = viewProjection * model * vec4(vPos, 1.0);
 }
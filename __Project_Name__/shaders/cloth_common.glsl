@@ -0,0 +1,27 @@
+// storage bindings shared by the cloth kernels, set up by ClothCompute
+// positions are tightly packed vec3, the same buffer is drawn as vertex data
+
+layout (std430, binding = 0) buffer Positions
+{
+  float position[];
+};
+
+layout (std430, binding = 1) readonly buffer InverseMass
+{
+  float inverseMass[];
+};
+
+vec3 loadPosition(uint i)
+{
+  return vec3(position[3u * i], position[3u * i + 1u], position[3u * i + 2u]);
+}
+
+void storePosition(uint i, vec3 p)
+{
+  position[3u * i] = p.x;
+  position[3u * i + 1u] = p.y;
+  position[3u * i + 2u] = p.z;
+}
+
+// below this a constraint has no direction to correct along
+const float MIN_LENGTH = 1e-6;
@@ -0,0 +1,339 @@
+#include "AllocationTracker.hpp"
+
+#include <imgui.h>
+
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#ifdef _MSC_VER
+# include <malloc.h>
+#endif
+
+constinit AllocationTracker::Thread AllocationTracker::s_threads[AllocationTracker::MAX_THREADS];
+constinit std::atomic<uint32_t> AllocationTracker::s_threadCount = 0;
+
+// read by every allocation, written by endFrame() and the setters
+static constinit std::atomic<uint32_t> s_armed = 0;
+static constinit std::atomic<bool> s_asserting = false;
+
+static constinit thread_local AllocationTracker::Phase t_phase = AllocationTracker::Phase::other;
+
+AllocationTracker &AllocationTracker::get()
+{
+  static AllocationTracker tracker;
+  return tracker;
+}
+
+AllocationTracker::Phase AllocationTracker::enter(Phase phase)
+{
+  const Phase previous = t_phase;
+  t_phase = phase;
+  return previous;
+}
+
+AllocationTracker::Thread &AllocationTracker::local()
+{
+  static constinit thread_local Thread *thread = nullptr;
+
+  // threads past the last slot share it
+  if (!thread)
+    thread = &s_threads[std::min(s_threadCount.fetch_add(1, std::memory_order_acq_rel), MAX_THREADS - 1)];
+  return *thread;
+}
+
+void AllocationTracker::setThreadName(const char *name)
+{
+  Thread &thread = local();
+
+  strncpy(thread.name, name, sizeof(thread.name) - 1);
+  thread.named.store(true, std::memory_order_release);
+}
+
+void AllocationTracker::onAllocate(size_t size)
+{
+  Thread &thread = local();
+  const size_t phase = (size_t)t_phase;
+
+  thread.allocations[phase].fetch_add(1, std::memory_order_relaxed);
+  thread.bytes[phase].fetch_add(size, std::memory_order_relaxed);
+
+  // the caller of this allocation is on the stack
+  assert(!(s_asserting.load(std::memory_order_relaxed) && (s_armed.load(std::memory_order_relaxed) >> phase & 1))
+    && "allocation in a guarded phase");
+}
+
+void AllocationTracker::onFree()
+{
+  local().frees[(size_t)t_phase].fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocationTracker::endFrame()
+{
+  std::lock_guard lock(m_lock);
+
+  const uint32_t threads = std::min(s_threadCount.load(std::memory_order_acquire), MAX_THREADS);
+  const uint32_t guarded = m_guarded.load(std::memory_order_relaxed);
+  const bool armed = (m_frame >= m_guardedSince.load(std::memory_order_relaxed) + WARMUP_FRAMES);
+
+  for (uint32_t t = 0; t < threads; ++t)
+  {
+    for (size_t p = 0; p < PHASES; ++p)
+    {
+      const Counters current = {
+        s_threads[t].allocations[p].load(std::memory_order_relaxed),
+        s_threads[t].frees[p].load(std::memory_order_relaxed),
+        s_threads[t].bytes[p].load(std::memory_order_relaxed),
+      };
+
+      Counters &total = m_totals[t][p];
+      m_last[t][p] = { current.allocations - total.allocations, current.frees - total.frees, current.bytes - total.bytes };
+      total = current;
+
+      if (armed && (guarded >> p & 1) && m_last[t][p].allocations)
+      {
+        m_violations.fetch_add(1, std::memory_order_relaxed);
+        m_lastViolationThread = t;
+        m_lastViolationPhase = (Phase)p;
+      }
+    }
+  }
+
+  ++m_frame;
+  s_armed.store(armed ? guarded : 0, std::memory_order_relaxed);
+}
+
+void AllocationTracker::guard(Phase phase, bool enabled)
+{
+  std::lock_guard lock(m_lock);
+
+  const uint32_t bit = 1u << (uint32_t)phase;
+  if (enabled)
+    m_guarded.fetch_or(bit, std::memory_order_relaxed);
+  else
+    m_guarded.fetch_and(~bit, std::memory_order_relaxed);
+
+  // every change starts a new warm up
+  m_guardedSince.store(m_frame, std::memory_order_relaxed);
+  s_armed.store(0, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::guarded(Phase phase) const
+{
+  return m_guarded.load(std::memory_order_relaxed) >> (uint32_t)phase & 1;
+}
+
+void AllocationTracker::setAssert(bool enabled)
+{
+  s_asserting.store(enabled, std::memory_order_relaxed);
+}
+
+bool AllocationTracker::asserting() const
+{
+  return s_asserting.load(std::memory_order_relaxed);
+}
+
+AllocationTracker::Counters AllocationTracker::lastFrame() const
+{
+  std::lock_guard lock(m_lock);
+
+  Counters sum;
+  for (uint32_t t = 0; t < MAX_THREADS; ++t)
+  {
+    for (size_t p = 0; p < PHASES; ++p)
+    {
+      sum.allocations += m_last[t][p].allocations;
+      sum.frees += m_last[t][p].frees;
+      sum.bytes += m_last[t][p].bytes;
+    }
+  }
+  return sum;
+}
+
+const char *AllocationTracker::phaseName(Phase phase)
+{
+  switch (phase)
+  {
+  case Phase::events: return "events";
+  case Phase::update: return "update";
+  case Phase::render: return "render";
+  case Phase::ui: return "ui";
+  default: return "other";
+  }
+}
+
+void AllocationTracker::drawUi(bool *open)
+{
+  if (!ImGui::Begin("Allocations", open))
+  {
+    ImGui::End();
+    return;
+  }
+
+  // copied out so the frame thread isn't held up by the drawing
+  Counters last[MAX_THREADS][PHASES];
+  uint32_t violationThread;
+  Phase violationPhase;
+  {
+    std::lock_guard lock(m_lock);
+    std::memcpy(last, m_last, sizeof(last));
+    violationThread = m_lastViolationThread;
+    violationPhase = m_lastViolationPhase;
+  }
+
+  const Counters total = lastFrame();
+  ImGui::Text("Last frame: %llu allocations, %llu frees, %.1f KB",
+    (unsigned long long)total.allocations, (unsigned long long)total.frees, total.bytes / 1024.0f);
+
+  const uint32_t threads = std::min(s_threadCount.load(std::memory_order_acquire), MAX_THREADS);
+  if (ImGui::BeginTable("allocations", (int)PHASES + 1, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+  {
+    ImGui::TableSetupColumn("Thread");
+    for (size_t p = 0; p < PHASES; ++p)
+      ImGui::TableSetupColumn(phaseName((Phase)p));
+    ImGui::TableHeadersRow();
+
+    for (uint32_t t = 0; t < threads; ++t)
+    {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      if (s_threads[t].named.load(std::memory_order_acquire))
+        ImGui::TextUnformatted(s_threads[t].name);
+      else
+        ImGui::Text("thread %u", t);
+
+      for (size_t p = 0; p < PHASES; ++p)
+      {
+        ImGui::TableNextColumn();
+        if (last[t][p].allocations)
+          ImGui::Text("%llu (%.1f KB)", (unsigned long long)last[t][p].allocations, last[t][p].bytes / 1024.0f);
+      }
+    }
+
+    ImGui::EndTable();
+  }
+
+  ImGui::TextUnformatted("Guard:");
+  for (size_t p = 0; p < PHASES; ++p)
+  {
+    bool enabled = guarded((Phase)p);
+    ImGui::SameLine();
+    if (ImGui::Checkbox(phaseName((Phase)p), &enabled))
+      guard((Phase)p, enabled);
+  }
+
+#ifndef NDEBUG
+  bool assertOnViolation = asserting();
+  if (ImGui::Checkbox("Assert on allocation", &assertOnViolation))
+    setAssert(assertOnViolation);
+#endif
+
+  if (violations())
+  {
+    const char *thread = s_threads[violationThread].named.load(std::memory_order_acquire) ? s_threads[violationThread].name : "unnamed thread";
+    ImGui::Text("%llu violations, last in %s on %s",
+      (unsigned long long)violations(), phaseName(violationPhase), thread);
+  }
+
+  ImGui::End();
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+// replacements of every global operator new and delete, they count and forward to malloc and free
+
+static void *tracked_allocate(size_t size)
+{
+  AllocationTracker::onAllocate(size);
+
+  // malloc(0) may return null, operator new may not
+  if (void *memory = std::malloc(size ? size : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+static void *tracked_allocate(size_t size, std::align_val_t alignment)
+{
+  AllocationTracker::onAllocate(size);
+
+#ifdef _MSC_VER
+  void *memory = _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+  void *memory = nullptr;
+  if (posix_memalign(&memory, std::max((size_t)alignment, sizeof(void *)), size ? size : 1) != 0)
+    memory = nullptr;
+#endif
+
+  if (memory)
+    return memory;
+  throw std::bad_alloc();
+}
+
+static void tracked_free(void *memory)
+{
+  if (!memory)
+    return;
+
+  AllocationTracker::onFree();
+  std::free(memory);
+}
+
+static void tracked_free(void *memory, std::align_val_t)
+{
+  if (!memory)
+    return;
+
+  AllocationTracker::onFree();
+#ifdef _MSC_VER
+  _aligned_free(memory);
+#else
+  std::free(memory);
+#endif
+}
+
+void *operator new(size_t size) { return tracked_allocate(size); }
+void *operator new[](size_t size) { return tracked_allocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return tracked_allocate(size, alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return tracked_allocate(size, alignment); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  try { return tracked_allocate(size); }
+  catch (...) { return nullptr; }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  try { return tracked_allocate(size); }
+  catch (...) { return nullptr; }
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  try { return tracked_allocate(size, alignment); }
+  catch (...) { return nullptr; }
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+  try { return tracked_allocate(size, alignment); }
+  catch (...) { return nullptr; }
+}
+
+void operator delete(void *memory) noexcept { tracked_free(memory); }
+void operator delete[](void *memory) noexcept { tracked_free(memory); }
+void operator delete(void *memory, size_t) noexcept { tracked_free(memory); }
+void operator delete[](void *memory, size_t) noexcept { tracked_free(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { tracked_free(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { tracked_free(memory); }
+
+void operator delete(void *memory, std::align_val_t alignment) noexcept { tracked_free(memory, alignment); }
+void operator delete[](void *memory, std::align_val_t alignment) noexcept { tracked_free(memory, alignment); }
+void operator delete(void *memory, size_t, std::align_val_t alignment) noexcept { tracked_free(memory, alignment); }
+void operator delete[](void *memory, size_t, std::align_val_t alignment) noexcept { tracked_free(memory, alignment); }
+void operator delete(void *memory, std::align_val_t alignment, const std::nothrow_t &) noexcept { tracked_free(memory, alignment); }
+void operator delete[](void *memory, std::align_val_t alignment, const std::nothrow_t &) noexcept { tracked_free(memory, alignment); }
+
+#endif
@@ -4,102 +4,328 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 
+#include <chrono>
+#include <iterator>
+#include <algorithm>
+
+// checkerboard, so folds stay readable without lighting
 constexpr glm::vec3 colors[] = {
-    { 1.0f, 0.0f, 0.0f },
-    { 0.0f, 1.0f, 0.0f },
-    { 0.5f, 0.0f, 1.0f }
+    { 0.9f, 0.3f, 0.2f },
+    { 0.95f, 0.9f, 0.8f }
 };
+constexpr uint32_t checker_size = 16;
+
+// gusts through the cloth plane, so it doesn't just hang there
+static glm::vec3 gust(float time)
+{
+  return { 0.0f, 0.0f, 3.0f * sin(time * 0.7f) + 1.5f * sin(time * 2.3f) };
+}
 
 void App::init()
 {
   // init opengl test scene
-  m_shader.addFile(Shader::Type::vertex, "shaders/cloth.vert");
-  m_shader.addFile(Shader::Type::fragment, "shaders/cloth.frag");
-  m_shader.compile();
+  // built in the background while the rest of the scene is set up
+  m_shader = &shaders.load("cloth", {
+    { Shader::Type::vertex, "shaders/cloth.vert" },
+    { Shader::Type::fragment, "shaders/cloth.frag" },
+  });
+  m_shader->setBlockBinding("Frame", FRAME_BINDING);
+
+  m_cloth.create(cloth_resolution, cloth_resolution, cloth_size, cloth_top);
+
+  m_gpu_supported = Compute::supported();
+  if (m_gpu_supported)
+  {
+    m_gpu_cloth.load(shaders);
+    m_gpu_cloth.create(m_cloth);
+    m_validation_gpu.load(shaders);
+  }
+
+  const size_t particles = m_cloth.particles();
+  m_positions.resize(particles);
+  m_cloth.positions(m_positions.data());
+
+  ClothState &state = m_state.back();
+  state.previous = m_positions;
+  state.current = m_positions;
+  m_state.publish();
+
+  std::vector<glm::vec3> vertexColors(particles);
+  for (uint32_t row = 0; row < m_cloth.height(); ++row)
+    for (uint32_t column = 0; column < m_cloth.width(); ++column)
+      vertexColors[row * m_cloth.width() + column] = colors[(row / checker_size + column / checker_size) % 2];
+
+  const std::vector<uint32_t> indices = m_cloth.triangles();
 
   glGenVertexArrays(1, &m_vertex_array);
   glBindVertexArray(m_vertex_array);
 
-  glGenBuffers(1, &m_position_buffer);
+  m_position_stream.create(sizeof(glm::vec3) * particles, sizeof(glm::vec3));
   glGenBuffers(1, &m_color_buffer);
+  glGenBuffers(1, &m_index_buffer);
 
-  glBindBuffer(GL_ARRAY_BUFFER, m_position_buffer);
-  glEnableVertexArrayAttrib(m_vertex_array, m_shader.getAttribute("vPos"));
-  glVertexAttribPointer(m_shader.getAttribute("vPos"), 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 3, positions, GL_DYNAMIC_DRAW);
+  // the pointer into the stream is set every frame, the region moves around the ring
+  glEnableVertexAttribArray(POSITION_LOCATION);
 
   glBindBuffer(GL_ARRAY_BUFFER, m_color_buffer);
-  glEnableVertexArrayAttrib(m_vertex_array, m_shader.getAttribute("vCol"));
-  glVertexAttribPointer(m_shader.getAttribute("vCol"), 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 3, colors, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(COLOR_LOCATION);
+  glVertexAttribPointer(COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * particles, vertexColors.data(), GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+  // the same buffers without the batch's instance attributes, for the draws recorded by jobs
+  glGenVertexArrays(1, &m_command_vertex_array);
+  glBindVertexArray(m_command_vertex_array);
+  glEnableVertexAttribArray(POSITION_LOCATION);
+
+  glBindBuffer(GL_ARRAY_BUFFER, m_color_buffer);
+  glEnableVertexAttribArray(COLOR_LOCATION);
+  glVertexAttribPointer(COLOR_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_index_buffer);
+
+  // the model matrix and tint come from the batch's instance attributes
+  m_mesh = batch.addMesh({ m_vertex_array, GL_TRIANGLES, (GLsizei)indices.size(), 0, 0, GL_UNSIGNED_INT });
 
-  camera.position = { 0.2, 0.0, 1.5 };
-  camera.rotation = { 0.0, 0.0 };
+  camera.setPosition({ 0.2, 0.0, 2.0 });
+  camera.setRotation(0.0f, 0.0f);
   camera.setProjection(Camera::ProjType::perspective);
 
+  setTickRate(tick_rate);
+  setRenderThread(true);
+
   glDisable(GL_CULL_FACE);
 }
 
 void App::stop()
 {
-  m_shader.clear();
+  m_shader = nullptr;
 
-  if (glIsBuffer(m_position_buffer))
-    glDeleteBuffers(1, &m_position_buffer);
+  m_gpu_cloth.destroy();
+  m_validation_gpu.destroy();
+  m_position_stream.destroy();
   if (glIsBuffer(m_color_buffer))
     glDeleteBuffers(1, &m_color_buffer);
+  if (glIsBuffer(m_index_buffer))
+    glDeleteBuffers(1, &m_index_buffer);
   if (glIsVertexArray(m_vertex_array))
     glDeleteVertexArrays(1, &m_vertex_array);
+  if (glIsVertexArray(m_command_vertex_array))
+    glDeleteVertexArrays(1, &m_command_vertex_array);
 }
 
 #include <iostream>
 
 void App::update(float timestep)
 {
-  constexpr float radius = 0.12f;
-  constexpr float loop_period = 5.0f;
+  // the render thread owns the GL context, it runs the ticks of the compute path
+  if (m_use_gpu.load(std::memory_order_relaxed))
+  {
+    m_pending_ticks.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  // simulated time, so the gusts stay in step with the fixed tick rate
+  m_time += timestep;
+  m_cloth.settings.wind = gust(m_time);
+
+  const auto start = std::chrono::steady_clock::now();
+  m_cloth.step(timestep, jobs);
+  m_stepTime.store(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+  ClothState &state = m_state.back();
+
+  state.previous = m_positions;
+  m_cloth.positions(m_positions.data());
+  state.current = m_positions;
+
+  m_state.publish();
+}
+
+void App::render()
+{
+  // ahead of the culling, a comparison keeps going while the cloth is off screen
+  if (m_validate.exchange(false) && m_gpu_cloth.ready())
+  {
+    m_validation_cloth.create(validation_resolution, validation_resolution, cloth_size, cloth_top);
+    m_validation_cloth.settings.wind = gust(1.0f);
+    m_validation_gpu.create(m_validation_cloth);
+    m_validation_left = validation_steps;
+  }
+
+  if (m_validation_left)
+    validate();
+
+  if (!camera.getFrustum().intersects(cloth_top, bounding_radius))
+    return;
+
+  if (m_use_gpu && m_gpu_cloth.ready())
+  {
+    // catch up with the ticks counted since the last frame, a slow frame drops what it can't
+    const uint32_t ticks = std::min(m_pending_ticks.exchange(0, std::memory_order_relaxed), max_gpu_ticks);
+    const float tick = (float)(1.0 / tick_rate);
+
+    for (uint32_t i = 0; i < ticks; ++i)
+    {
+      m_gpu_time += tick;
+      m_gpu_cloth.settings.wind = gust(m_gpu_time);
+      m_gpu_cloth.step(tick);
+    }
 
-  constexpr auto sigmoid = [](float x) { return 1.0f / (1.0f + exp(-5.0f * x)); };
+    // written in place by the kernels, already behind a vertex attribute barrier
+    glBindVertexArray(m_vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, m_gpu_cloth.positionBuffer());
+    glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-  constexpr auto altered_sigmoid = [](float x) {
-    const float s0 = sigmoid(0 - 0.5f);
-    const float s1 = sigmoid(1 - 0.5f);
+    draw();
+    return;
+  }
 
-    const float scale = s1 - s0;
+  m_state.acquire();
+  m_position_stream.beginFrame();
 
-    return (sigmoid(x - 0.5f)) / scale - s0;
-  };
+  // blend the last two simulation steps so motion stays smooth between fixed ticks
+  const ClothState &state = m_state.front();
+  const float alpha = interpolation();
 
-  const float time = (float)glfwGetTime();
+  const uint32_t count = (uint32_t)state.current.size();
+  const StreamingBuffer::Allocation vertices = m_position_stream.allocate(sizeof(glm::vec3) * count);
+  glm::vec3 *positions = (glm::vec3 *)vertices.data;
 
-  // time loops back after loop_period seconds
-  const float clamped = glm::mod(time, loop_period) / loop_period;
+  const UniformBuffer::Allocation frame = uniforms.push(FrameUniforms{ camera.getViewProj() });
+  uniforms.flush();
 
-  const float s = altered_sigmoid(clamped);
-  const float angle1 = glm::radians(s * 360.0f);
-  const float angle2 = glm::radians(s * 360.0f + 120.0f);
-  const float angle3 = glm::radians(s * 360.0f + 240.0f);
+  const Shader &shader = *m_shader;
+  const GLuint program = shader.id();
+  const uint64_t key = CommandList::drawKey(0, program, m_command_vertex_array);
+  const CommandList::UniformRange frameBlock = { uniforms.id(), FRAME_BINDING, frame.offset, frame.size };
 
-  positions[0] = glm::vec3( 0.0f + cos(angle1) * radius,    0.5f + sin(angle1) * radius,   0.0f);
-  positions[1] = glm::vec3(-0.5f + cos(angle2) * radius,   -0.5f + sin(angle2) * radius,   0.0f);
-  positions[2] = glm::vec3( 0.5f + cos(angle3) * radius,   -0.5f + sin(angle3) * radius,   0.0f);
+  // the model matrix and tint the batch would have streamed, as constant attributes ahead of the bands
+  if (program)
+    commands.record().callback(key, set_instance, RenderBatch::Instance{ glm::mat4(1.0f) });
+
+  // each job interpolates a band of rows and records the triangles joining it to the next one,
+  // the replay sorts the bands by their first row and joins them back into a single draw
+  constexpr uint32_t quad_row_indices = (cloth_resolution - 1) * 6;
+
+  jobs.wait(jobs.parallel_for(cloth_resolution, band_rows, [&](uint32_t begin, uint32_t end)
+  {
+    // write only, the mapping may be uncached
+    for (uint32_t i = begin * cloth_resolution; i < std::min(end * cloth_resolution, count); ++i)
+      positions[i] = glm::mix(state.previous[i], state.current[i], alpha);
+
+    const uint32_t last = std::min(end, cloth_resolution - 1);
+    if (!program || begin >= last)
+      return;
+
+    CommandList::Draw draw;
+    draw.program = program;
+    draw.vertexArray = m_command_vertex_array;
+    draw.indexType = GL_UNSIGNED_INT;
+    draw.first = begin * quad_row_indices;
+    draw.count = (GLsizei)((last - begin) * quad_row_indices);
+    draw.blocks[0] = frameBlock;
+
+    commands.record(1 + begin).draw(key, draw);
+  }));
+
+  m_position_stream.flush();
+
+  glBindVertexArray(m_command_vertex_array);
+  glBindBuffer(GL_ARRAY_BUFFER, m_position_stream.id());
+  glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, (const void *)vertices.offset);
+
+  // replayed here rather than after render() so the stream's fence covers the draws reading it
+  commands.submit();
+
+  m_position_stream.endFrame();
 }
 
-void App::render()
+void App::set_instance(const RenderBatch::Instance &instance)
 {
-  glBindVertexArray(m_vertex_array);
+  // arrays disabled on the vertex array, the shader reads these current values instead
+  for (GLuint column = 0; column < 4; ++column)
+    glVertexAttrib4fv(RenderBatch::MODEL_LOCATION + column, &instance.model[column][0]);
+  glVertexAttrib4fv(RenderBatch::TINT_LOCATION, &instance.tint[0]);
+}
+
+void App::draw()
+{
+  // the compute path has nothing to prepare on the CPU, its single draw goes through the batch
+  const UniformBuffer::Allocation frame = uniforms.push(FrameUniforms{ camera.getViewProj() });
+  uniforms.flush();
+  uniforms.bind(FRAME_BINDING, frame);
 
-  glBindBuffer(GL_ARRAY_BUFFER, m_position_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * 3, positions, GL_DYNAMIC_DRAW);
+  batch.submit(*m_shader, m_mesh, { glm::mat4(1.0f) });
+  batch.flush();
+}
 
-  glUseProgram(m_shader.id());
+void App::validate()
+{
+  // both solvers from the same state with the same wind, a tick each per frame
+  const float tick = (float)(1.0 / tick_rate);
+  m_validation_cloth.step(tick, jobs);
+  m_validation_gpu.step(tick);
 
-  glm::mat4 mvp = camera.getProj() * camera.getView();
-  glUniformMatrix4fv(m_shader.getUniform("MVP"), 1, GL_FALSE, glm::value_ptr(mvp));
-  glDrawArrays(GL_TRIANGLES, 0, 3);
+  // the only read back, on a grid small enough for the wait not to matter
+  if (--m_validation_left == 0)
+  {
+    m_gpu_error = m_validation_gpu.compare(m_validation_cloth);
+    m_validation_gpu.destroy();
+  }
+}
+
+static void pacing_stats(const char *label, const FramePacer::Stats &stats)
+{
+  constexpr auto us = [](FramePacer::clock::duration d) { return std::chrono::duration<float, std::micro>(d).count(); };
+
+  ImGui::Text("%s: last %.1fus  mean %.1fus  max %.1fus  jitter %.1fus",
+    label, us(stats.lastError), us(stats.meanError), us(stats.maxError), us(stats.jitter));
 }
 
 void App::update_ui()
 {
   ImGui::ShowDemoWindow();
+
+  ImGui::Begin("Pacing");
+  pacing_stats("frame", framePacing());
+  pacing_stats("update", updatePacing());
+
+  // same order as Window::Pacing
+  static constexpr const char *modes[] = { "vsync", "uncapped", "target fps", "low latency" };
+
+  int mode = (int)window.pacing();
+  float fps = (float)window.targetFps();
+  bool changed = ImGui::Combo("pacing", &mode, modes, (int)std::size(modes));
+  if (mode == (int)Window::Pacing::target)
+    changed |= ImGui::SliderFloat("target fps", &fps, 15.0f, 480.0f, "%.0f");
+  if (changed)
+    window.setPacing((Window::Pacing)mode, fps);
+
+  constexpr auto ms = [](Window::clock::duration d) { return std::chrono::duration<float, std::milli>(d).count(); };
+  const Window::Latency latency = window.latency();
+  ImGui::Text("latency: last %.2fms  mean %.2fms  max %.2fms  render %.2fms",
+    ms(latency.last), ms(latency.mean), ms(latency.max), ms(latency.render));
+  ImGui::Text("shaders: %zu reloaded, %zu failed", shaderReloader.reloaded(), shaderReloader.failed());
+  ImGui::End();
+
+  ImGui::Begin("Cloth");
+  ImGui::Text("%zu particles, %zu constraints in %zu colors", m_cloth.particles(), m_cloth.constraints(), m_cloth.colors());
+  ImGui::Text("step: %.2fms", m_stepTime.load(std::memory_order_relaxed));
+
+  if (m_gpu_supported)
+  {
+    bool gpu = m_use_gpu;
+    if (ImGui::Checkbox("compute shaders", &gpu))
+      m_use_gpu = gpu;
+
+    if (ImGui::Button("compare with CPU"))
+      m_validate = true;
+
+    if (m_gpu_error >= 0.0f)
+      ImGui::Text("largest difference after %u steps on a %ux%u grid: %g",
+        validation_steps, validation_resolution, validation_resolution, m_gpu_error.load());
+  }
+  ImGui::End();
 }
\ No newline at end of file
@@ -9,118 +9,74 @@
 #include <backends/imgui_impl_opengl3.h>
 
 #include <chrono>
+#include <fstream>
+#include <algorithm>
 #include <iostream>
 
-using namespace std::chrono_literals;
 namespace chrono = std::chrono;
-using loop_clock = chrono::steady_clock;
-using clock_unit = chrono::milliseconds;
 
 Application::Application() : window(*this) {}
 
-void Application::run()
+void Application::setTickRate(double ticksPerSecond)
 {
-  running = true;
-
-  _init();
-  loop();
-  _stop();
+  if (ticksPerSecond <= 0.0)
+    m_tickInterval = loop_clock::duration::zero();
+  else
+    m_tickInterval = chrono::duration_cast<loop_clock::duration>(chrono::duration<double>(1.0 / ticksPerSecond));
 }
 
-// callbacks
-static void error_callback(int error, const char *description)
+void Application::setRenderThread(bool enabled)
 {
-  fprintf(stderr, "Error: %s\n", description);
+  m_useRenderThread = enabled;
 }
 
-
-void Application::timed_loop(std::function<bool(void)> conditionChecker, std::function<void(float)> function)
+void Application::setFrameDump(const std::filesystem::path &path)
 {
-  // cap the loop to a minimum interval to ensure a good deltatime acuracy
-  constexpr auto LOOP_TRESHOLD = 1ms;
-
-  loop_clock::time_point now;
-  loop_clock::time_point last = loop_clock::now();
-
-  while (conditionChecker())
-  {
-    now = loop_clock::now();
-    chrono::duration elapsed = now - last;
-
-    if (elapsed < LOOP_TRESHOLD)
-    {
-      std::this_thread::sleep_for(LOOP_TRESHOLD - elapsed);
-      elapsed = LOOP_TRESHOLD;
-    }
-
-    const float deltatime = chrono::duration_cast<clock_unit>(elapsed).count() / 1000.0f;
-    function(deltatime);
-    last = now;
-  }
+  m_dumpPath = path;
 }
 
-
-void Application::loop()
+float Application::interpolation() const
 {
-  m_updating = false;
-
-  m_updateThread = std::thread(&Application::updateLoop, this);
-
-  while (!m_updating);
+  if (m_tickInterval == loop_clock::duration::zero())
+    return 1.0f;
 
-  timed_loop(
-    [this]() { return (running && window.isOpen()); },
-    [this](float deltatime) {
-      window.update();
+  const loop_clock::time_point lastTick(loop_clock::duration(m_lastTick.load(std::memory_order_acquire)));
+  const float alpha = clock_unit(loop_clock::now() - lastTick) / clock_unit(m_tickInterval);
 
-      const bool isMouseGrabbed = (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_NORMAL);
-      if (isMouseGrabbed && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2) == GLFW_PRESS)
-        camera.update(deltatime, window);
-
-      _update_ui();
-      _render();
-    }
-  );
-  running = false;
-
-  m_updateThread.join();
+  return glm::clamp(alpha, 0.0f, 1.0f);
 }
 
-void Application::updateLoop()
+void Application::run(Window::Mode mode, uint64_t frameCount)
 {
-  timed_loop(
-    [this]() { return !!running; },
-    [this](float deltatime) {
-      _update(deltatime);
-      m_updating = true;
-    }
-  );
+  _run(*this, mode, frameCount);
 }
 
-/// This function isn't used anymore due to imgui requirement of having opengl context and glfw events on the same thread
-void Application::renderLoop()
+// callbacks
+static void error_callback(int error, const char *description)
 {
-  while (!m_updating);
-
-  window.grabRenderingContext();
-
-  timed_loop(
-    [this]() { return (running && window.isOpen()); },
-    [this](float) { _render(); }
-  );
-
-  window.releaseRenderingContext();
-  running = false;
+  fprintf(stderr, "Error: %s\n", description);
 }
 
 
-void Application::_init()
+void Application::_init(Window::Mode mode)
 {
-  glfwInit();
+  const bool headless = (mode == Window::Mode::headless);
+
+#ifdef GLFW_PLATFORM_NULL
+  // no display server required, the context comes from OSMesa or surfaceless EGL
+  if (headless && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
   glfwSetErrorCallback(error_callback);
+  glfwInit();
 
-  window.create(PROJECT_NAME, 1280, 720);
-  window.setVSync(true);
+  if (!window.create(PROJECT_NAME, 1280, 720, mode))
+  {
+    fprintf(stderr, "Error: unable to create the %s window\n", headless ? "headless" : "application");
+    abort();
+  }
+  window.setPacing(headless ? Window::Pacing::uncapped : Window::Pacing::vsync);
 
   {
     ImGui::CreateContext();
@@ -128,11 +84,17 @@ void Application::_init()
   
     ImGuiIO &io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-    io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
     io.ConfigDockingWithShift = true;
+
+    // platform windows need a desktop, and batch runs shouldn't leave an imgui.ini behind
+    if (headless)
+      io.IniFilename = nullptr;
+    else
+      io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
   
     ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init();
+    // core profiles reject the backend's default #version 130 shaders
+    ImGui_ImplOpenGL3_Init("#version 330 core");
   }
 
   camera.setProjection(Camera::ProjType::perspective);
@@ -141,15 +103,65 @@ void Application::_init()
   glDisable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
 
+  jobs.start();
+  // linked programs are copied out on this thread and written to the binary cache by the workers
+  Shader::setCacheWriter(&jobs);
+  uniforms.create(UNIFORMS_PER_FRAME);
+  batch.create(INSTANCES_PER_FRAME);
+
+  const auto compileStart = std::chrono::steady_clock::now();
+
   init();
+
+  // every program init() loaded has been submitted, this only waits for the slowest one
+  const size_t failed = shaders.wait();
+  const std::chrono::duration<float, std::milli> compileTime = std::chrono::steady_clock::now() - compileStart;
+  printf("Compiled %zu shader programs in %.1fms, %zu failed\n", shaders.size(), compileTime.count(), failed);
+
+  // nobody edits shaders during a batch run
+  if (!headless)
+  {
+    shaders.watch(&shaderReloader);
+    shaderReloader.start();
+  }
+
+  // ImGui's glfw backend needs the main thread, a headless run has no events to keep it busy with
+  m_useRenderThread = m_useRenderThread && !headless;
+  if (m_useRenderThread)
+  {
+    // platform windows would be rendered by the main thread, which no longer has a context
+    ImGui::GetIO().ConfigFlags &= ~ImGuiConfigFlags_ViewportsEnable;
+
+    // creates the font texture and the backend's program while this thread still has the context
+    ImGui_ImplOpenGL3_NewFrame();
+  }
 }
 
 void Application::_stop()
 {
   running = false;
 
+  // the loops are gone, the frame they left in the framebuffer is the last one
+  if (!m_dumpPath.empty())
+  {
+    if (_dump_frame(m_dumpPath))
+      printf("Wrote the last frame to %s\n", m_dumpPath.string().c_str());
+    else
+      fprintf(stderr, "Error: unable to write the last frame to %s\n", m_dumpPath.string().c_str());
+  }
+
+  shaderReloader.stop();
   stop();
 
+  shaders.clear();
+
+  // writes still queued are dropped, those programs are built again by the next run
+  Shader::setCacheWriter(nullptr);
+  jobs.stop();
+  batch.destroy();
+  uniforms.destroy();
+  Profiler::get().shutdown();
+
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
@@ -158,29 +170,77 @@ void Application::_stop()
   glfwTerminate();
 }
 
-void Application::_update(float timestep)
+bool Application::_dump_frame(const std::filesystem::path &path) const
 {
-  update(timestep);
+  if (!window.isHeadless())
+    return false;
+
+  std::vector<uint8_t> pixels;
+  if (!window.readPixels(pixels))
+    return false;
+
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs)
+    return false;
+
+  const glm::ivec2 size = window.size();
+  ofs << "P6\n" << size.x << " " << size.y << "\n255\n";
+
+  // GL rows are bottom-up, PPM rows top-down, and PPM has no alpha
+  std::vector<char> row((size_t)size.x * 3);
+  for (int y = size.y - 1; y >= 0; --y)
+  {
+    const uint8_t *rgba = &pixels[(size_t)y * size.x * 4];
+    for (int x = 0; x < size.x; ++x)
+    {
+      row[x * 3 + 0] = (char)rgba[x * 4 + 0];
+      row[x * 3 + 1] = (char)rgba[x * 4 + 1];
+      row[x * 3 + 2] = (char)rgba[x * 4 + 2];
+    }
+    ofs.write(row.data(), (std::streamsize)row.size());
+  }
+
+  return (bool)ofs;
 }
 
-void Application::_render()
+void Application::_begin_render()
 {
+  uniforms.beginFrame();
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  
-  render();
-  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-  window.render();
 }
 
+void Application::_end_render()
+{
+  commands.submit();
+  batch.flush();
 
-void Application::_update_ui()
+  PROFILE_GPU_SCOPE("imgui");
+  if (!m_useRenderThread)
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  else if (m_uiFrames.front().drawData.Valid)
+    ImGui_ImplOpenGL3_RenderDrawData(&m_uiFrames.front().drawData);
+
+  uniforms.endFrame();
+}
+
+
+void Application::_begin_ui()
 {
-  ImGui_ImplOpenGL3_NewFrame();
+  if (!m_useRenderThread)
+    ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
 
   ImGui::NewFrame();
+}
+
+void Application::_end_ui()
+{
+  if (m_showProfiler)
+    Profiler::get().drawUi(&m_showProfiler);
 
-  update_ui();
+  if (AllocationTracker::ENABLED && m_showAllocations)
+    AllocationTracker::get().drawUi(&m_showAllocations);
 
   ImGui::EndFrame();
 
@@ -197,8 +257,121 @@ void Application::_update_ui()
   }
 }
 
+void Application::_publish_ui()
+{
+  m_uiFrames.back().copy(*ImGui::GetDrawData());
+  m_uiFrames.publish();
+  m_uiPending.store(true, std::memory_order_release);
+}
+
+// unlike the assignment operator, resize() keeps the memory unless it has to grow
+template <typename T>
+static void copy_vector(ImVector<T> &to, const ImVector<T> &from)
+{
+  to.resize(from.Size);
+  if (from.Size)
+    memcpy(to.Data, from.Data, from.size_in_bytes());
+}
+
+Application::UiFrame::~UiFrame()
+{
+  for (ImDrawList *list : lists)
+    IM_DELETE(list);
+}
+
+void Application::UiFrame::copy(ImDrawData &source)
+{
+  // the list vectors are set aside so the assignment only copies the other fields
+  ImVector<ImDrawList *> sourceLists;
+  ImVector<ImDrawList *> copiedLists;
+  sourceLists.swap(source.CmdLists);
+  copiedLists.swap(drawData.CmdLists);
+
+  drawData = source;
+
+  source.CmdLists.swap(sourceLists);
+  drawData.CmdLists.swap(copiedLists);
+
+  while (lists.Size < source.CmdLists.Size)
+    lists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+  drawData.CmdLists.resize(source.CmdLists.Size);
+  for (int i = 0; i < source.CmdLists.Size; ++i)
+  {
+    const ImDrawList &from = *source.CmdLists[i];
+    ImDrawList &to = *lists[i];
+
+    // what CloneOutput() copies, the backend reads nothing else
+    copy_vector(to.CmdBuffer, from.CmdBuffer);
+    copy_vector(to.IdxBuffer, from.IdxBuffer);
+    copy_vector(to.VtxBuffer, from.VtxBuffer);
+    to.Flags = from.Flags;
+
+    drawData.CmdLists[i] = &to;
+  }
+}
+
+void Application::_forward(const WindowEvent &event)
+{
+  // keeps the order of the events behind those already waiting
+  if (m_eventBacklog.empty() && m_events.push(event))
+    return;
+
+  m_eventBacklog.push_back(event);
+}
+
+void Application::_forward_backlog()
+{
+  size_t sent = 0;
+  while (sent < m_eventBacklog.size() && m_events.push(m_eventBacklog[sent]))
+    ++sent;
+
+  m_eventBacklog.erase(m_eventBacklog.begin(), m_eventBacklog.begin() + sent);
+}
+
+void Application::_process_events()
+{
+  PROFILE_SCOPE("events");
+
+  WindowEvent event;
+  while (m_events.pop(event))
+  {
+    switch (event.type)
+    {
+    case WindowEvent::Type::resize:
+      glViewport(0, 0, event.width, event.height);
+      camera.setViewport(event.width, event.height);
+      break;
+    case WindowEvent::Type::key:
+      _camera_key(event.key);
+      break;
+    }
+  }
+}
+
+void Application::_process_input(float timestep)
+{
+  PROFILE_SCOPE("camera.update");
+
+  const InputState &input = window.input().update();
+
+  if (input.grabbed && input.buttonDown(GLFW_MOUSE_BUTTON_2))
+    camera.update(timestep, input, m_lastInput);
+
+  m_lastInput = input;
+}
+
 void Application::onResize(Window &window, int width, int height)
 {
+  if (m_renderThread.joinable())
+  {
+    WindowEvent event = { WindowEvent::Type::resize };
+    event.width = width;
+    event.height = height;
+    _forward(event);
+    return;
+  }
+
   glViewport(0, 0, width, height);
   camera.setViewport(width, height);
 }
@@ -215,11 +388,15 @@ void Application::onClick(Window &window, int button, int action, int mods)
       glfwGetCursorPos(window, &m_cursorSave.x, &m_cursorSave.y);
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
       glfwSetCursorPos(window, 0, 0);
+      window.input().warp(0, 0);
+      window.input().grab(true);
     }
     else if (action == GLFW_RELEASE)
     {
       glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
       glfwSetCursorPos(window, m_cursorSave.x, m_cursorSave.y);
+      window.input().warp(m_cursorSave.x, m_cursorSave.y);
+      window.input().grab(false);
     }
   }
 }
@@ -235,6 +412,28 @@ void Application::onKeyboard(Window &window, int key, int scancode, int action,
   if (action != GLFW_PRESS)
     return;
 
+  if (key == GLFW_KEY_F3)
+    m_showProfiler = !m_showProfiler;
+
+  if (key == GLFW_KEY_F4)
+    m_showAllocations = !m_showAllocations;
+
+  if (key != GLFW_KEY_P && key != GLFW_KEY_O)
+    return;
+
+  // the camera belongs to the render thread while it runs
+  if (m_renderThread.joinable())
+  {
+    WindowEvent event = { WindowEvent::Type::key };
+    event.key = key;
+    _forward(event);
+  }
+  else
+    _camera_key(key);
+}
+
+void Application::_camera_key(int key)
+{
   if (key == GLFW_KEY_P)
   {
     if (camera.getProjectionType() == Camera::ProjType::perspective)
@@ -246,10 +445,10 @@ void Application::onKeyboard(Window &window, int key, int scancode, int action,
   if (key == GLFW_KEY_O)
   {
     std::cout << "Camera:\n"
-      << "  x: " << camera.position.x << "\n"
-      << "  y: " << camera.position.y << "\n"
-      << "  z: " << camera.position.z << "\n"
-      << "  yaw: " << camera.yaw << "\n"
-      << "  pitch: " << camera.pitch << std::endl;
+      << "  x: " << camera.getPosition().x << "\n"
+      << "  y: " << camera.getPosition().y << "\n"
+      << "  z: " << camera.getPosition().z << "\n"
+      << "  yaw: " << camera.getYaw() << "\n"
+      << "  pitch: " << camera.getPitch() << std::endl;
   }
 }
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "Cloth.hpp"
+#include "Profiler.hpp"
+
+#include <bit>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CLOTH_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CLOTH_SSE
+#endif
+
+// large enough that a job outweighs its scheduling, small enough to spread a color over every core
+static constexpr uint32_t PARTICLE_GRAIN = 4096;
+static constexpr uint32_t CONSTRAINT_GRAIN = 2048;
+
+// below this a constraint has no direction to correct along
+static constexpr float MIN_LENGTH = 1e-6f;
+
+void Cloth::create(uint32_t width, uint32_t height, float size, const glm::vec3 &top)
+{
+  m_width = width;
+  m_height = height;
+
+  const size_t count = (size_t)width * height;
+  const float spacing = size / (float)(std::max(width, 2u) - 1);
+
+  m_x.resize(count);
+  m_y.resize(count);
+  m_z.resize(count);
+  m_inverseMass.assign(count, 1.0f);
+
+  for (uint32_t row = 0; row < height; ++row)
+  {
+    for (uint32_t column = 0; column < width; ++column)
+    {
+      const size_t i = (size_t)row * width + column;
+      m_x[i] = top.x - size * 0.5f + spacing * column;
+      m_y[i] = top.y - spacing * row;
+      m_z[i] = top.z;
+    }
+  }
+
+  m_px = m_x;
+  m_py = m_y;
+  m_pz = m_z;
+
+  m_a.clear();
+  m_b.clear();
+  m_rest.clear();
+  m_bend.clear();
+
+  const auto index = [width](uint32_t column, uint32_t row) { return row * width + column; };
+
+  for (uint32_t row = 0; row < height; ++row)
+  {
+    for (uint32_t column = 0; column < width; ++column)
+    {
+      // structural
+      if (column + 1 < width)
+        addConstraint(index(column, row), index(column + 1, row), false);
+      if (row + 1 < height)
+        addConstraint(index(column, row), index(column, row + 1), false);
+
+      // shear
+      if (column + 1 < width && row + 1 < height)
+      {
+        addConstraint(index(column, row), index(column + 1, row + 1), false);
+        addConstraint(index(column + 1, row), index(column, row + 1), false);
+      }
+
+      // bending, across every other particle
+      if (column + 2 < width)
+        addConstraint(index(column, row), index(column + 2, row), true);
+      if (row + 2 < height)
+        addConstraint(index(column, row), index(column, row + 2), true);
+    }
+  }
+
+  color();
+
+  // an empty cloth has no corners to hang from
+  if (count == 0)
+    return;
+
+  pin(index(0, 0));
+  pin(index(width - 1, 0));
+}
+
+void Cloth::pin(uint32_t particle, bool pinned)
+{
+  m_inverseMass[particle] = pinned ? 0.0f : 1.0f;
+  m_tethered = false;
+}
+
+void Cloth::setPosition(uint32_t particle, const glm::vec3 &position)
+{
+  m_x[particle] = m_px[particle] = position.x;
+  m_y[particle] = m_py[particle] = position.y;
+  m_z[particle] = m_pz[particle] = position.z;
+}
+
+void Cloth::addConstraint(uint32_t a, uint32_t b, bool bend)
+{
+  const float dx = m_x[b] - m_x[a];
+  const float dy = m_y[b] - m_y[a];
+  const float dz = m_z[b] - m_z[a];
+
+  m_a.push_back(a);
+  m_b.push_back(b);
+  m_rest.push_back(std::sqrt(dx * dx + dy * dy + dz * dz));
+  m_bend.push_back(bend ? 1.0f : 0.0f);
+}
+
+void Cloth::color()
+{
+  const size_t count = m_a.size();
+
+  // greedy: each constraint takes the lowest color none of its particles has yet.
+  // A grid particle belongs to at most 12 constraints, so no more than 23 colors are needed
+  std::vector<uint64_t> used(m_x.size(), 0);
+  std::vector<uint8_t> colorOf(count);
+  uint32_t colors = 0;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint32_t color = (uint32_t)std::countr_one(used[m_a[i]] | used[m_b[i]]);
+
+    colorOf[i] = (uint8_t)color;
+    used[m_a[i]] |= 1ull << color;
+    used[m_b[i]] |= 1ull << color;
+    colors = std::max(colors, color + 1);
+  }
+
+  // counting sort by color, constraints keep their grid order inside a color for locality
+  m_colors.assign(colors + 1, 0);
+  for (uint8_t color : colorOf)
+    ++m_colors[color + 1];
+  for (uint32_t c = 0; c < colors; ++c)
+    m_colors[c + 1] += m_colors[c];
+
+  std::vector<uint32_t> next(m_colors.begin(), m_colors.end() - 1);
+  std::vector<uint32_t> a(count), b(count);
+  std::vector<float> rest(count), bend(count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint32_t slot = next[colorOf[i]]++;
+    a[slot] = m_a[i];
+    b[slot] = m_b[i];
+    rest[slot] = m_rest[i];
+    bend[slot] = m_bend[i];
+  }
+
+  m_a = std::move(a);
+  m_b = std::move(b);
+  m_rest = std::move(rest);
+  m_bend = std::move(bend);
+}
+
+void Cloth::step(float timestep, JobSystem &jobs)
+{
+  PROFILE_SCOPE("cloth.step");
+
+  if (m_x.empty() || settings.substeps == 0)
+    return;
+
+  if (!m_tethered)
+    attach();
+
+  const float dt = timestep / (float)settings.substeps;
+  const glm::vec3 displacement = (settings.gravity + settings.wind) * dt * dt;
+
+  const float stiffness = iterationStiffness(settings.stiffness, settings.iterations);
+  const float bendStiffness = iterationStiffness(settings.bendStiffness, settings.iterations);
+
+  // every color depends on the previous one, the whole step is one chain of jobs waited on once
+  JobSystem::Handle previous;
+
+  for (uint32_t substep = 0; substep < settings.substeps; ++substep)
+  {
+    previous = jobs.parallel_for((uint32_t)m_x.size(), PARTICLE_GRAIN,
+      [this, displacement](uint32_t begin, uint32_t end) { integrate(begin, end, displacement); }, { previous });
+
+    for (uint32_t iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+      for (size_t c = 0; c + 1 < m_colors.size(); ++c)
+      {
+        const uint32_t first = m_colors[c];
+
+        previous = jobs.parallel_for(m_colors[c + 1] - first, CONSTRAINT_GRAIN,
+          [this, first, stiffness, bendStiffness](uint32_t begin, uint32_t end) { project(first + begin, first + end, stiffness, bendStiffness); },
+          { previous });
+      }
+    }
+
+    if (!m_tether.empty())
+      previous = jobs.parallel_for((uint32_t)m_x.size(), PARTICLE_GRAIN,
+        [this](uint32_t begin, uint32_t end) { tether(begin, end); }, { previous });
+  }
+
+  jobs.wait(previous);
+}
+
+float Cloth::iterationStiffness(float stiffness, uint32_t iterations)
+{
+  return 1.0f - std::pow(1.0f - std::clamp(stiffness, 0.0f, 1.0f), 1.0f / (float)std::max(iterations, 1u));
+}
+
+void Cloth::integrate(uint32_t begin, uint32_t end, const glm::vec3 &displacement)
+{
+  float *x = m_x.data(), *y = m_y.data(), *z = m_z.data();
+  float *px = m_px.data(), *py = m_py.data(), *pz = m_pz.data();
+  const float *w = m_inverseMass.data();
+  const float damping = settings.damping;
+
+  // verlet, branchless so it vectorizes: pinned particles never move so their velocity stays 0
+  for (uint32_t i = begin; i < end; ++i)
+  {
+    const float free = w[i] > 0.0f ? 1.0f : 0.0f;
+
+    const float vx = (x[i] - px[i]) * damping;
+    const float vy = (y[i] - py[i]) * damping;
+    const float vz = (z[i] - pz[i]) * damping;
+
+    px[i] = x[i];
+    py[i] = y[i];
+    pz[i] = z[i];
+
+    x[i] += vx + displacement.x * free;
+    y[i] += vy + displacement.y * free;
+    z[i] += vz + displacement.z * free;
+  }
+}
+
+void Cloth::project(uint32_t begin, uint32_t end, float stiffness, float bendStiffness)
+{
+  float *x = m_x.data(), *y = m_y.data(), *z = m_z.data();
+  const float *w = m_inverseMass.data();
+  const uint32_t *a = m_a.data(), *b = m_b.data();
+  const float *rest = m_rest.data(), *bend = m_bend.data();
+
+  uint32_t i = begin;
+
+  // the particles are gathered lane by lane, the math runs on all of them at once.
+  // Constraints of a color share no particle so the lanes scatter back without conflicts
+#if defined(CLOTH_AVX)
+  for (; i + 8 <= end; i += 8)
+  {
+    const uint32_t *ia = a + i;
+    const uint32_t *ib = b + i;
+
+#define GATHER(array, index) _mm256_setr_ps(array[index[0]], array[index[1]], array[index[2]], array[index[3]], \
+                                             array[index[4]], array[index[5]], array[index[6]], array[index[7]])
+    const __m256 xa = GATHER(x, ia), ya = GATHER(y, ia), za = GATHER(z, ia), wa = GATHER(w, ia);
+    const __m256 xb = GATHER(x, ib), yb = GATHER(y, ib), zb = GATHER(z, ib), wb = GATHER(w, ib);
+#undef GATHER
+
+    const __m256 dx = _mm256_sub_ps(xb, xa);
+    const __m256 dy = _mm256_sub_ps(yb, ya);
+    const __m256 dz = _mm256_sub_ps(zb, za);
+    const __m256 length = _mm256_sqrt_ps(_mm256_max_ps(
+      _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)),
+      _mm256_set1_ps(MIN_LENGTH * MIN_LENGTH)));
+
+    // k * (length - rest) / ((wa + wb) * length), 0 when both ends are pinned
+    const __m256 k = _mm256_add_ps(_mm256_set1_ps(stiffness), _mm256_mul_ps(_mm256_loadu_ps(bend + i), _mm256_set1_ps(bendStiffness - stiffness)));
+    const __m256 weight = _mm256_add_ps(wa, wb);
+    const __m256 movable = _mm256_cmp_ps(weight, _mm256_setzero_ps(), _CMP_GT_OQ);
+    const __m256 scale = _mm256_and_ps(movable, _mm256_div_ps(
+      _mm256_mul_ps(k, _mm256_sub_ps(length, _mm256_loadu_ps(rest + i))),
+      _mm256_mul_ps(_mm256_max_ps(weight, _mm256_set1_ps(MIN_LENGTH)), length)));
+
+    const __m256 cx = _mm256_mul_ps(dx, scale);
+    const __m256 cy = _mm256_mul_ps(dy, scale);
+    const __m256 cz = _mm256_mul_ps(dz, scale);
+
+    alignas(32) float out[6][8];
+    _mm256_store_ps(out[0], _mm256_add_ps(xa, _mm256_mul_ps(cx, wa)));
+    _mm256_store_ps(out[1], _mm256_add_ps(ya, _mm256_mul_ps(cy, wa)));
+    _mm256_store_ps(out[2], _mm256_add_ps(za, _mm256_mul_ps(cz, wa)));
+    _mm256_store_ps(out[3], _mm256_sub_ps(xb, _mm256_mul_ps(cx, wb)));
+    _mm256_store_ps(out[4], _mm256_sub_ps(yb, _mm256_mul_ps(cy, wb)));
+    _mm256_store_ps(out[5], _mm256_sub_ps(zb, _mm256_mul_ps(cz, wb)));
+
+    for (int lane = 0; lane < 8; ++lane)
+    {
+      x[ia[lane]] = out[0][lane];
+      y[ia[lane]] = out[1][lane];
+      z[ia[lane]] = out[2][lane];
+      x[ib[lane]] = out[3][lane];
+      y[ib[lane]] = out[4][lane];
+      z[ib[lane]] = out[5][lane];
+    }
+  }
+#elif defined(CLOTH_SSE)
+  for (; i + 4 <= end; i += 4)
+  {
+    const uint32_t *ia = a + i;
+    const uint32_t *ib = b + i;
+
+#define GATHER(array, index) _mm_setr_ps(array[index[0]], array[index[1]], array[index[2]], array[index[3]])
+    const __m128 xa = GATHER(x, ia), ya = GATHER(y, ia), za = GATHER(z, ia), wa = GATHER(w, ia);
+    const __m128 xb = GATHER(x, ib), yb = GATHER(y, ib), zb = GATHER(z, ib), wb = GATHER(w, ib);
+#undef GATHER
+
+    const __m128 dx = _mm_sub_ps(xb, xa);
+    const __m128 dy = _mm_sub_ps(yb, ya);
+    const __m128 dz = _mm_sub_ps(zb, za);
+    const __m128 length = _mm_sqrt_ps(_mm_max_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)),
+      _mm_set1_ps(MIN_LENGTH * MIN_LENGTH)));
+
+    // k * (length - rest) / ((wa + wb) * length), 0 when both ends are pinned
+    const __m128 k = _mm_add_ps(_mm_set1_ps(stiffness), _mm_mul_ps(_mm_loadu_ps(bend + i), _mm_set1_ps(bendStiffness - stiffness)));
+    const __m128 weight = _mm_add_ps(wa, wb);
+    const __m128 movable = _mm_cmpgt_ps(weight, _mm_setzero_ps());
+    const __m128 scale = _mm_and_ps(movable, _mm_div_ps(
+      _mm_mul_ps(k, _mm_sub_ps(length, _mm_loadu_ps(rest + i))),
+      _mm_mul_ps(_mm_max_ps(weight, _mm_set1_ps(MIN_LENGTH)), length)));
+
+    const __m128 cx = _mm_mul_ps(dx, scale);
+    const __m128 cy = _mm_mul_ps(dy, scale);
+    const __m128 cz = _mm_mul_ps(dz, scale);
+
+    alignas(16) float out[6][4];
+    _mm_store_ps(out[0], _mm_add_ps(xa, _mm_mul_ps(cx, wa)));
+    _mm_store_ps(out[1], _mm_add_ps(ya, _mm_mul_ps(cy, wa)));
+    _mm_store_ps(out[2], _mm_add_ps(za, _mm_mul_ps(cz, wa)));
+    _mm_store_ps(out[3], _mm_sub_ps(xb, _mm_mul_ps(cx, wb)));
+    _mm_store_ps(out[4], _mm_sub_ps(yb, _mm_mul_ps(cy, wb)));
+    _mm_store_ps(out[5], _mm_sub_ps(zb, _mm_mul_ps(cz, wb)));
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+      x[ia[lane]] = out[0][lane];
+      y[ia[lane]] = out[1][lane];
+      z[ia[lane]] = out[2][lane];
+      x[ib[lane]] = out[3][lane];
+      y[ib[lane]] = out[4][lane];
+      z[ib[lane]] = out[5][lane];
+    }
+  }
+#endif
+
+  for (; i < end; ++i)
+  {
+    const uint32_t ia = a[i];
+    const uint32_t ib = b[i];
+
+    const float weight = w[ia] + w[ib];
+    if (weight <= 0.0f)
+      continue;
+
+    const float dx = x[ib] - x[ia];
+    const float dy = y[ib] - y[ia];
+    const float dz = z[ib] - z[ia];
+    const float length = std::sqrt(std::max(dx * dx + dy * dy + dz * dz, MIN_LENGTH * MIN_LENGTH));
+
+    const float k = stiffness + bend[i] * (bendStiffness - stiffness);
+    const float scale = k * (length - rest[i]) / (weight * length);
+
+    x[ia] += dx * scale * w[ia];
+    y[ia] += dy * scale * w[ia];
+    z[ia] += dz * scale * w[ia];
+    x[ib] -= dx * scale * w[ib];
+    y[ib] -= dy * scale * w[ib];
+    z[ib] -= dz * scale * w[ib];
+  }
+}
+
+void Cloth::attach()
+{
+  m_tethered = true;
+
+  std::vector<uint32_t> pins;
+  for (uint32_t i = 0; i < m_inverseMass.size(); ++i)
+    if (m_inverseMass[i] == 0.0f)
+      pins.push_back(i);
+
+  m_tether.clear();
+  m_tetherLength.clear();
+  if (pins.empty())
+    return;
+
+  // the grid is flat when it is pinned, so the straight distance is also the distance along the cloth
+  m_tether.resize(m_x.size());
+  m_tetherLength.resize(m_x.size());
+
+  for (size_t i = 0; i < m_x.size(); ++i)
+  {
+    float closest = INFINITY;
+    for (uint32_t pin : pins)
+    {
+      const float dx = m_x[i] - m_x[pin];
+      const float dy = m_y[i] - m_y[pin];
+      const float dz = m_z[i] - m_z[pin];
+      const float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+      if (length < closest)
+      {
+        closest = length;
+        m_tether[i] = pin;
+      }
+    }
+    m_tetherLength[i] = closest;
+  }
+}
+
+void Cloth::tether(uint32_t begin, uint32_t end)
+{
+  float *x = m_x.data(), *y = m_y.data(), *z = m_z.data();
+  const float *w = m_inverseMass.data();
+
+  // pins never move, every particle only writes itself
+  for (uint32_t i = begin; i < end; ++i)
+  {
+    const uint32_t pin = m_tether[i];
+
+    const float dx = x[i] - x[pin];
+    const float dy = y[i] - y[pin];
+    const float dz = z[i] - z[pin];
+    const float length = std::sqrt(std::max(dx * dx + dy * dy + dz * dz, MIN_LENGTH * MIN_LENGTH));
+
+    if (w[i] == 0.0f || length <= m_tetherLength[i])
+      continue;
+
+    const float scale = (length - m_tetherLength[i]) / length;
+    x[i] -= dx * scale;
+    y[i] -= dy * scale;
+    z[i] -= dz * scale;
+  }
+}
+
+void Cloth::positions(glm::vec3 *out) const
+{
+  for (size_t i = 0; i < m_x.size(); ++i)
+    out[i] = glm::vec3(m_x[i], m_y[i], m_z[i]);
+}
+
+std::vector<uint32_t> Cloth::triangles() const
+{
+  std::vector<uint32_t> indices;
+  if (m_width < 2 || m_height < 2)
+    return indices;
+
+  indices.reserve((size_t)(m_width - 1) * (m_height - 1) * 6);
+
+  for (uint32_t row = 0; row + 1 < m_height; ++row)
+  {
+    for (uint32_t column = 0; column + 1 < m_width; ++column)
+    {
+      const uint32_t i = row * m_width + column;
+
+      indices.insert(indices.end(), { i, i + m_width, i + 1 });
+      indices.insert(indices.end(), { i + 1, i + m_width, i + m_width + 1 });
+    }
+  }
+
+  return indices;
+}
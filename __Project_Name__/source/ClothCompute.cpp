@@ -0,0 +1,185 @@
+#include "ClothCompute.hpp"
+#include "Profiler.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+void ClothCompute::load(ShaderLibrary &shaders)
+{
+  m_integrate.shader = &kernel(shaders, "cloth_integrate", "shaders/cloth_integrate.comp");
+  m_project.shader = &kernel(shaders, "cloth_project", "shaders/cloth_project.comp");
+  m_tether.shader = &kernel(shaders, "cloth_tether", "shaders/cloth_tether.comp");
+}
+
+Shader &ClothCompute::kernel(ShaderLibrary &shaders, const std::string &name, const std::filesystem::path &file)
+{
+  // loading it again would rebuild it
+  if (Shader *shader = shaders.get(name))
+    return *shader;
+
+  return shaders.load(name, { { Shader::Type::compute, file } });
+}
+
+void ClothCompute::dispatch(Kernel &kernel, uint32_t items)
+{
+  const GLuint program = kernel.shader->id();
+  if (program != kernel.program)
+  {
+    kernel.program = program;
+    kernel.localSize = Compute::localSize(*kernel.shader).x;
+  }
+
+  Compute::dispatch(*kernel.shader, items, kernel.localSize);
+}
+
+bool ClothCompute::create(Cloth &cloth)
+{
+  destroy();
+
+  if (!cloth.m_tethered)
+    cloth.attach();
+
+  m_particles = cloth.particles();
+  settings = cloth.settings;
+  m_colors = cloth.m_colors;
+
+  // interleaved for the vertex stage, the kernels read them as plain floats
+  std::vector<glm::vec3> positions(m_particles);
+  std::vector<glm::vec3> previous(m_particles);
+  for (size_t i = 0; i < m_particles; ++i)
+  {
+    positions[i] = glm::vec3(cloth.m_x[i], cloth.m_y[i], cloth.m_z[i]);
+    previous[i] = glm::vec3(cloth.m_px[i], cloth.m_py[i], cloth.m_pz[i]);
+  }
+
+  std::vector<glm::uvec2> constraints(cloth.constraints());
+  for (size_t i = 0; i < constraints.size(); ++i)
+    constraints[i] = glm::uvec2(cloth.m_a[i], cloth.m_b[i]);
+
+  // a cloth without pins has no tethers, the kernel is skipped but the bindings still need a buffer
+  std::vector<uint32_t> tethers = cloth.m_tether;
+  std::vector<float> tetherLengths = cloth.m_tetherLength;
+  tethers.resize(std::max<size_t>(tethers.size(), 1));
+  tetherLengths.resize(std::max<size_t>(tetherLengths.size(), 1));
+
+  bool created = true;
+  created &= m_positions.create(sizeof(glm::vec3) * m_particles, positions.data());
+  created &= m_previous.create(sizeof(glm::vec3) * m_particles, previous.data());
+  created &= m_inverseMass.create(sizeof(float) * m_particles, cloth.m_inverseMass.data(), GL_STATIC_DRAW);
+  created &= m_constraints.create(sizeof(glm::uvec2) * constraints.size(), constraints.data(), GL_STATIC_DRAW);
+  created &= m_rest.create(sizeof(float) * cloth.m_rest.size(), cloth.m_rest.data(), GL_STATIC_DRAW);
+  created &= m_bend.create(sizeof(float) * cloth.m_bend.size(), cloth.m_bend.data(), GL_STATIC_DRAW);
+  created &= m_tethers.create(sizeof(uint32_t) * tethers.size(), tethers.data(), GL_STATIC_DRAW);
+  created &= m_tetherLengths.create(sizeof(float) * tetherLengths.size(), tetherLengths.data(), GL_STATIC_DRAW);
+
+  m_tethered = !cloth.m_tether.empty();
+  return created;
+}
+
+void ClothCompute::destroy()
+{
+  m_positions.destroy();
+  m_previous.destroy();
+  m_inverseMass.destroy();
+  m_constraints.destroy();
+  m_rest.destroy();
+  m_bend.destroy();
+  m_tethers.destroy();
+  m_tetherLengths.destroy();
+
+  m_particles = 0;
+}
+
+bool ClothCompute::ready() const
+{
+  return m_particles && m_integrate.shader && m_project.shader && m_tether.shader
+      && m_integrate.shader->id() && m_project.shader->id() && m_tether.shader->id();
+}
+
+void ClothCompute::step(float timestep)
+{
+  if (!ready() || settings.substeps == 0)
+    return;
+
+  PROFILE_SCOPE("cloth.compute");
+  PROFILE_GPU_SCOPE("cloth.compute");
+
+  const float dt = timestep / (float)settings.substeps;
+  const glm::vec3 displacement = (settings.gravity + settings.wind) * dt * dt;
+  const uint32_t particles = (uint32_t)m_particles;
+
+  m_positions.bind(POSITION_BINDING);
+  m_inverseMass.bind(INVERSE_MASS_BINDING);
+  m_previous.bind(PREVIOUS_BINDING);
+  m_constraints.bind(CONSTRAINT_BINDING);
+  m_rest.bind(REST_BINDING);
+  m_bend.bind(BEND_BINDING);
+  m_tethers.bind(TETHER_BINDING);
+  m_tetherLengths.bind(TETHER_LENGTH_BINDING);
+
+  // only the color range changes between the projection dispatches
+  Shader &integrateShader = *m_integrate.shader;
+  const GLuint integrate = integrateShader.id();
+  glProgramUniform1ui(integrate, integrateShader.getUniform("count"), particles);
+  glProgramUniform3f(integrate, integrateShader.getUniform("displacement"), displacement.x, displacement.y, displacement.z);
+  glProgramUniform1f(integrate, integrateShader.getUniform("damping"), settings.damping);
+
+  Shader &projectShader = *m_project.shader;
+  const GLuint project = projectShader.id();
+  const GLint first = projectShader.getUniform("first");
+  const GLint count = projectShader.getUniform("count");
+  glProgramUniform1f(project, projectShader.getUniform("stiffness"), Cloth::iterationStiffness(settings.stiffness, settings.iterations));
+  glProgramUniform1f(project, projectShader.getUniform("bendStiffness"), Cloth::iterationStiffness(settings.bendStiffness, settings.iterations));
+
+  glProgramUniform1ui(m_tether.shader->id(), m_tether.shader->getUniform("count"), particles);
+
+  for (uint32_t substep = 0; substep < settings.substeps; ++substep)
+  {
+    dispatch(m_integrate, particles);
+    Compute::barrier();
+
+    for (uint32_t iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+      for (size_t c = 0; c + 1 < m_colors.size(); ++c)
+      {
+        glProgramUniform1ui(project, first, m_colors[c]);
+        glProgramUniform1ui(project, count, m_colors[c + 1] - m_colors[c]);
+
+        dispatch(m_project, m_colors[c + 1] - m_colors[c]);
+        Compute::barrier();
+      }
+    }
+
+    if (m_tethered)
+    {
+      dispatch(m_tether, particles);
+      Compute::barrier();
+    }
+  }
+
+  // the positions are drawn next
+  Compute::barrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void ClothCompute::positions(glm::vec3 *out) const
+{
+  m_positions.download(out, sizeof(glm::vec3) * m_particles);
+}
+
+float ClothCompute::compare(const Cloth &reference) const
+{
+  if (reference.particles() != m_particles)
+    return INFINITY;
+
+  std::vector<glm::vec3> gpu(m_particles);
+  positions(gpu.data());
+
+  float error = 0.0f;
+  for (size_t i = 0; i < m_particles; ++i)
+  {
+    const glm::vec3 cpu(reference.m_x[i], reference.m_y[i], reference.m_z[i]);
+    error = std::max(error, glm::length(gpu[i] - cpu));
+  }
+
+  return error;
+}
@@ -0,0 +1,156 @@
+#include "CommandList.hpp"
+#include "Profiler.hpp"
+
+#include <iterator>
+#include <algorithm>
+
+void CommandList::draw(uint64_t key, const Draw &draw)
+{
+  Draw *command = m_arena.create<Draw>(draw);
+
+  m_entries.push_back({ key, Type::draw, command });
+}
+
+void CommandList::clear()
+{
+  m_entries.clear();
+  m_arena.reset();
+}
+
+CommandList &CommandQueue::record(uint32_t order)
+{
+  std::lock_guard guard(m_lock);
+
+  // lists are handed out again every frame so their arenas keep their memory
+  if (m_recording == m_recordings.size())
+    m_recordings.push_back({ std::make_unique<CommandList>(), 0 });
+
+  Recording &recording = m_recordings[m_recording++];
+  recording.order = order;
+  return *recording.list;
+}
+
+void CommandQueue::submit()
+{
+  m_commandCount = 0;
+  m_drawCalls = 0;
+
+  std::lock_guard guard(m_lock);
+  if (m_recording == 0)
+    return;
+
+  PROFILE_SCOPE("commands.submit");
+
+  m_sorted.clear();
+  for (size_t r = 0; r < m_recording; ++r)
+  {
+    const std::vector<CommandList::Entry> &entries = m_recordings[r].list->entries();
+    for (uint32_t i = 0; i < entries.size(); ++i)
+      m_sorted.push_back({ entries[i].key, m_recordings[r].order, i, &entries[i] });
+  }
+
+  // lists are handed out in whatever order the jobs ran, ties go by order then recording order
+  std::sort(m_sorted.begin(), m_sorted.end(), [](const Sorted &a, const Sorted &b)
+  {
+    if (a.key != b.key)
+      return a.key < b.key;
+    if (a.order != b.order)
+      return a.order < b.order;
+    return a.index < b.index;
+  });
+
+  State state;
+  CommandList::Draw pending;
+  bool hasPending = false;
+
+  for (const Sorted &sorted : m_sorted)
+  {
+    const CommandList::Entry &entry = *sorted.entry;
+
+    if (entry.type == CommandList::Type::draw)
+    {
+      const CommandList::Draw &draw = *(const CommandList::Draw *)entry.data;
+
+      if (hasPending && mergeable(pending, draw))
+      {
+        pending.count += draw.count;
+        continue;
+      }
+
+      if (hasPending)
+        issue(pending, state);
+
+      pending = draw;
+      hasPending = true;
+      continue;
+    }
+
+    if (hasPending)
+      issue(pending, state);
+    hasPending = false;
+
+    const CommandList::Callback *callback = (const CommandList::Callback *)entry.data;
+    callback->invoke(callback);
+
+    // the callback may have changed any of it
+    state = State();
+  }
+
+  if (hasPending)
+    issue(pending, state);
+
+  m_commandCount = (uint32_t)m_sorted.size();
+
+  for (size_t r = 0; r < m_recording; ++r)
+    m_recordings[r].list->clear();
+  m_recording = 0;
+}
+
+bool CommandQueue::mergeable(const CommandList::Draw &a, const CommandList::Draw &b)
+{
+  // the second draw has to continue the range of the first, with the exact same state
+  return a.program == b.program && a.vertexArray == b.vertexArray
+      && a.mode == b.mode && a.indexType == b.indexType
+      && a.baseVertex == b.baseVertex
+      && a.instances == 1 && b.instances == 1
+      && a.first + (GLuint)a.count == b.first
+      && (a.mode == GL_POINTS || a.mode == GL_LINES || a.mode == GL_TRIANGLES)
+      && std::memcmp(a.blocks, b.blocks, sizeof(a.blocks)) == 0;
+}
+
+void CommandQueue::issue(const CommandList::Draw &draw, State &state)
+{
+  if (draw.program != state.program)
+    glUseProgram(state.program = draw.program);
+  if (draw.vertexArray != state.vertexArray)
+    glBindVertexArray(state.vertexArray = draw.vertexArray);
+
+  for (const CommandList::UniformRange &block : draw.blocks)
+  {
+    if (block.size == 0)
+      continue;
+
+    if (block.binding < std::size(state.blocks))
+    {
+      CommandList::UniformRange &bound = state.blocks[block.binding];
+      if (std::memcmp(&bound, &block, sizeof(block)) == 0)
+        continue;
+      bound = block;
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, block.binding, block.buffer, block.offset, block.size);
+  }
+
+  if (!draw.indexType)
+  {
+    glDrawArraysInstanced(draw.mode, (GLint)draw.first, draw.count, draw.instances);
+  }
+  else
+  {
+    const size_t indexSize = draw.indexType == GL_UNSIGNED_INT ? 4 : draw.indexType == GL_UNSIGNED_SHORT ? 2 : 1;
+    glDrawElementsInstancedBaseVertex(draw.mode, draw.count, draw.indexType, (const void *)(indexSize * draw.first),
+                                      draw.instances, draw.baseVertex);
+  }
+
+  ++m_drawCalls;
+}
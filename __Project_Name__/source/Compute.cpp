@@ -0,0 +1,107 @@
+#include "Compute.hpp"
+
+#include <cstring>
+
+bool StorageBuffer::create(GLsizeiptr size, const void *data, GLenum usage)
+{
+  destroy();
+
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  m_size = size;
+  return m_buffer != 0;
+}
+
+void StorageBuffer::destroy()
+{
+  if (m_buffer)
+    glDeleteBuffers(1, &m_buffer);
+
+  m_buffer = 0;
+  m_size = 0;
+}
+
+void StorageBuffer::upload(const void *data, GLsizeiptr size, GLintptr offset)
+{
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void StorageBuffer::download(void *data, GLsizeiptr size, GLintptr offset) const
+{
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_buffer);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void StorageBuffer::bind(GLuint binding) const
+{
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_buffer);
+}
+
+void StorageBuffer::bind(GLuint binding, GLintptr offset, GLsizeiptr size) const
+{
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, m_buffer, offset, size);
+}
+
+// glad may be generated without the ARB extensions, their names are looked up instead
+static bool extension_supported(const char *extension)
+{
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+  for (GLint i = 0; i < count; ++i)
+  {
+    const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+    if (name && !strcmp(name, extension))
+      return true;
+  }
+  return false;
+}
+
+bool Compute::supported()
+{
+  if (GLAD_GL_VERSION_4_3)
+    return true;
+
+  if (!extension_supported("GL_ARB_compute_shader") || !extension_supported("GL_ARB_shader_storage_buffer_object"))
+    return false;
+
+  // listed extensions are no use when glad was generated without them, their entry points were never loaded
+  return glDispatchCompute != nullptr && glMemoryBarrier != nullptr && glProgramUniform1ui != nullptr &&
+         glProgramUniform1f != nullptr && glProgramUniform3f != nullptr;
+}
+
+glm::uvec3 Compute::localSize(const Shader &shader)
+{
+  GLint size[3] = { 1, 1, 1 };
+  if (shader.id())
+    glGetProgramiv(shader.id(), GL_COMPUTE_WORK_GROUP_SIZE, size);
+
+  return { (uint32_t)size[0], (uint32_t)size[1], (uint32_t)size[2] };
+}
+
+void Compute::dispatch(const Shader &shader, const glm::uvec3 &groups)
+{
+  if (!shader.id() || !groups.x || !groups.y || !groups.z)
+    return;
+
+  glUseProgram(shader.id());
+  glDispatchCompute(groups.x, groups.y, groups.z);
+}
+
+void Compute::dispatch(const Shader &shader, uint32_t items, uint32_t localSize)
+{
+  dispatch(shader, glm::uvec3((items + localSize - 1) / localSize, 1, 1));
+}
+
+void Compute::barrier(GLbitfield barriers)
+{
+  glMemoryBarrier(barriers);
+}
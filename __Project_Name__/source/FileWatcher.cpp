@@ -0,0 +1,174 @@
+#include "FileWatcher.hpp"
+#include "Profiler.hpp"
+
+#include <set>
+#include <vector>
+#include <chrono>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+using namespace std::chrono_literals;
+
+// how long the files have to stay untouched before a burst of writes is reported
+static constexpr auto SETTLE_TIME = 50ms;
+static constexpr auto POLL_INTERVAL = 250ms;
+
+void FileWatcher::start(Callback callback)
+{
+  if (m_running)
+    return;
+
+  m_callback = std::move(callback);
+
+#ifdef __linux__
+  {
+    std::lock_guard guard(m_lock);
+
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    for (const auto &[path, _] : m_files)
+    {
+      const int descriptor = inotify_add_watch(m_inotify, path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+      if (descriptor >= 0)
+        m_directories[descriptor] = path.parent_path();
+    }
+  }
+#endif
+
+  m_running = true;
+  m_thread = std::thread(&FileWatcher::run, this);
+}
+
+void FileWatcher::stop()
+{
+  if (!m_running.exchange(false))
+    return;
+
+  m_thread.join();
+
+#ifdef __linux__
+  if (m_inotify >= 0)
+    close(m_inotify);
+#endif
+
+  m_inotify = -1;
+  m_directories.clear();
+}
+
+void FileWatcher::watch(const std::filesystem::path &file)
+{
+  const std::filesystem::path path = key(file);
+
+  std::error_code error;
+  std::lock_guard guard(m_lock);
+  m_files[path] = { file, std::filesystem::last_write_time(path, error) };
+
+#ifdef __linux__
+  if (m_inotify < 0)
+    return;
+
+  // a directory is only watched once, inotify hands back the same descriptor
+  const int descriptor = inotify_add_watch(m_inotify, path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (descriptor >= 0)
+    m_directories[descriptor] = path.parent_path();
+#endif
+}
+
+void FileWatcher::unwatch(const std::filesystem::path &file)
+{
+  // the directory watch stays, events for files no longer listed are ignored
+  std::lock_guard guard(m_lock);
+  m_files.erase(key(file));
+}
+
+std::filesystem::path FileWatcher::key(const std::filesystem::path &file)
+{
+  std::error_code error;
+  std::filesystem::path path = std::filesystem::weakly_canonical(std::filesystem::absolute(file, error), error);
+  return path.empty() ? file : path;
+}
+
+void FileWatcher::run()
+{
+  Profiler::setThreadName("file watcher");
+
+  if (m_inotify >= 0)
+    runInotify();
+  else
+    runPolling();
+}
+
+void FileWatcher::runInotify()
+{
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+  std::set<std::filesystem::path> changed;
+
+  while (m_running.load(std::memory_order_relaxed))
+  {
+    // short timeouts keep stop() responsive, and a pending burst is reported once it settles
+    pollfd descriptor = { m_inotify, POLLIN, 0 };
+    const int timeout = (int)std::chrono::milliseconds(changed.empty() ? POLL_INTERVAL : SETTLE_TIME).count();
+
+    if (poll(&descriptor, 1, timeout) <= 0)
+    {
+      for (const std::filesystem::path &path : changed)
+        m_callback(path);
+      changed.clear();
+      continue;
+    }
+
+    ssize_t length;
+    while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0)
+    {
+      std::lock_guard guard(m_lock);
+
+      for (char *it = buffer; it < buffer + length;)
+      {
+        const inotify_event *event = (const inotify_event *)it;
+        it += sizeof(inotify_event) + event->len;
+
+        if (event->len == 0 || !m_directories.contains(event->wd))
+          continue;
+
+        const auto file = m_files.find(m_directories.at(event->wd) / event->name);
+        if (file != m_files.end())
+          changed.insert(file->second.path);
+      }
+    }
+  }
+#endif
+}
+
+void FileWatcher::runPolling()
+{
+  std::vector<std::filesystem::path> changed;
+
+  while (m_running.load(std::memory_order_relaxed))
+  {
+    std::this_thread::sleep_for(POLL_INTERVAL);
+
+    {
+      std::lock_guard guard(m_lock);
+      for (auto &[path, file] : m_files)
+      {
+        std::error_code error;
+        const auto modified = std::filesystem::last_write_time(path, error);
+
+        if (!error && modified != file.modified)
+        {
+          file.modified = modified;
+          changed.push_back(file.path);
+        }
+      }
+    }
+
+    // the interval is longer than a save, the files have settled by now
+    for (const std::filesystem::path &path : changed)
+      m_callback(path);
+    changed.clear();
+  }
+}
@@ -0,0 +1,65 @@
+#include "FrameArena.hpp"
+
+#include <algorithm>
+
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+  while (m_block < m_blocks.size())
+  {
+    Block &block = m_blocks[m_block];
+
+    // aligned as an address, so types aligned past what new[] guarantees are fine too
+    const uintptr_t base = (uintptr_t)block.data.get();
+    const uintptr_t address = (base + m_used + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    const size_t offset = (size_t)(address - base);
+
+    if (offset + size <= block.size)
+    {
+      m_used = offset + size;
+      return block.data.get() + offset;
+    }
+
+    m_previous += block.size;
+    m_used = 0;
+    ++m_block;
+  }
+
+  // room for the worst case alignment padding
+  const size_t blockSize = std::max(size + alignment, m_blockSize);
+  m_blocks.push_back({ std::make_unique<std::byte[]>(blockSize), blockSize });
+
+  m_block = m_blocks.size() - 1;
+  return allocate(size, alignment);
+}
+
+void FrameArena::reset()
+{
+  m_peak = std::max(m_peak, used());
+
+  // this frame didn't fit in one block, the next ones get a single block as large as all of them
+  if (m_blocks.size() > 1)
+  {
+    const size_t total = capacity();
+
+    m_blocks.clear();
+    m_blocks.push_back({ std::make_unique<std::byte[]>(total), total });
+  }
+
+  m_block = 0;
+  m_used = 0;
+  m_previous = 0;
+}
+
+size_t FrameArena::capacity() const
+{
+  size_t total = 0;
+  for (const Block &block : m_blocks)
+    total += block.size;
+  return total;
+}
+
+FrameArena &FrameArena::local()
+{
+  thread_local FrameArena arena;
+  return arena;
+}
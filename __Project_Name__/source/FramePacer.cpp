@@ -0,0 +1,98 @@
+#include "FramePacer.hpp"
+
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+# include <immintrin.h>
+# define cpu_relax() _mm_pause()
+#else
+# define cpu_relax() ((void)0)
+#endif
+
+namespace chrono = std::chrono;
+using seconds = chrono::duration<double>;
+
+// weight of the newest sample in the moving averages
+static constexpr double SMOOTHING = 0.05;
+
+// the spin margin covers the mean sleep overshoot plus this many deviations
+static constexpr double SAFETY_DEVIATIONS = 3.0;
+
+void FramePacer::waitUntil(clock::time_point deadline)
+{
+  clock::time_point now = clock::now();
+
+  // running late, there is nothing to pace, but how late still counts
+  if (now >= deadline)
+  {
+    record(now - deadline);
+    return;
+  }
+
+  const seconds margin(m_overshootMean + SAFETY_DEVIATIONS * m_overshootDeviation);
+  const clock::duration sleepTime = (deadline - now) - chrono::duration_cast<clock::duration>(margin);
+
+  if (sleepTime > clock::duration::zero())
+  {
+    std::this_thread::sleep_for(sleepTime);
+
+    // learn how late the scheduler wakes us up to size the next spin margin
+    const clock::time_point woke = clock::now();
+    const double overshoot = seconds((woke - now) - sleepTime).count();
+    const double deviation = std::abs(overshoot - m_overshootMean);
+
+    m_overshootMean += (overshoot - m_overshootMean) * SMOOTHING;
+    m_overshootDeviation += (deviation - m_overshootDeviation) * SMOOTHING;
+    now = woke;
+  }
+
+  while (now < deadline)
+  {
+    cpu_relax();
+    now = clock::now();
+  }
+
+  record(now - deadline);
+}
+
+FramePacer::Stats FramePacer::stats() const
+{
+  return {
+    clock::duration(m_lastError.load(std::memory_order_relaxed)),
+    clock::duration(m_meanError.load(std::memory_order_relaxed)),
+    clock::duration(m_maxError.load(std::memory_order_relaxed)),
+    clock::duration(m_jitter.load(std::memory_order_relaxed)),
+    m_frames.load(std::memory_order_relaxed)
+  };
+}
+
+void FramePacer::resetStats()
+{
+  m_lastError = 0;
+  m_meanError = 0;
+  m_maxError = 0;
+  m_jitter = 0;
+  m_frames = 0;
+}
+
+void FramePacer::record(clock::duration error)
+{
+  const double value = (double)error.count();
+  const uint64_t frames = m_frames.load(std::memory_order_relaxed);
+
+  double mean = (double)m_meanError.load(std::memory_order_relaxed);
+  double jitter = (double)m_jitter.load(std::memory_order_relaxed);
+
+  if (frames == 0)
+    mean = value;
+  jitter += (std::abs(value - mean) - jitter) * SMOOTHING;
+  mean += (value - mean) * SMOOTHING;
+
+  m_lastError.store(error.count(), std::memory_order_relaxed);
+  m_meanError.store((clock::rep)mean, std::memory_order_relaxed);
+  m_jitter.store((clock::rep)jitter, std::memory_order_relaxed);
+  m_maxError.store(std::max(m_maxError.load(std::memory_order_relaxed), error.count()), std::memory_order_relaxed);
+  m_frames.store(frames + 1, std::memory_order_relaxed);
+}
@@ -0,0 +1,195 @@
+#include "Frustum.hpp"
+
+#include <bit>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+Frustum::Frustum(const glm::mat4 &viewProjection)
+{
+  // Gribb & Hartmann: each clip plane is the last row of the matrix plus or minus one of the others
+  const glm::mat4 m = glm::transpose(viewProjection);
+
+  m_planes[0] = m[3] + m[0]; // left
+  m_planes[1] = m[3] - m[0]; // right
+  m_planes[2] = m[3] + m[1]; // bottom
+  m_planes[3] = m[3] - m[1]; // top
+  m_planes[4] = m[3] + m[2]; // near
+  m_planes[5] = m[3] - m[2]; // far
+
+  // normalized so plane distances compare against radii
+  for (glm::vec4 &plane : m_planes)
+    plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::contains(const glm::vec3 &point) const
+{
+  for (const glm::vec4 &plane : m_planes)
+    if (glm::dot(glm::vec3(plane), point) + plane.w < 0.0f)
+      return false;
+  return true;
+}
+
+bool Frustum::intersects(const glm::vec3 &center, float radius) const
+{
+  for (const glm::vec4 &plane : m_planes)
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+      return false;
+  return true;
+}
+
+bool Frustum::intersects(const glm::vec3 &min, const glm::vec3 &max) const
+{
+  for (const glm::vec4 &plane : m_planes)
+  {
+    // the corner furthest along the normal, if it is outside the whole box is
+    const glm::vec3 corner = {
+      plane.x >= 0.0f ? max.x : min.x,
+      plane.y >= 0.0f ? max.y : min.y,
+      plane.z >= 0.0f ? max.z : min.z,
+    };
+
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+// appends first + the index of every set bit of mask
+static size_t append_visible(uint32_t mask, uint32_t first, uint32_t *visible)
+{
+  size_t count = 0;
+  for (; mask; mask &= mask - 1)
+    visible[count++] = first + (uint32_t)std::countr_zero(mask);
+  return count;
+}
+
+size_t Frustum::cull(const BoundingSpheres &spheres, uint32_t *visible) const
+{
+  const float *x = spheres.x.data();
+  const float *y = spheres.y.data();
+  const float *z = spheres.z.data();
+  const float *radius = spheres.radius.data();
+
+  const size_t count = spheres.size();
+  size_t written = 0;
+  size_t i = 0;
+
+#if defined(FRUSTUM_AVX)
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m256 cx = _mm256_loadu_ps(x + i);
+    const __m256 cy = _mm256_loadu_ps(y + i);
+    const __m256 cz = _mm256_loadu_ps(z + i);
+    const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const glm::vec4 &plane : m_planes)
+    {
+      const __m256 distance = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)), _mm256_mul_ps(cy, _mm256_set1_ps(plane.y))),
+        _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+    }
+
+    written += append_visible((uint32_t)_mm256_movemask_ps(inside), (uint32_t)i, visible + written);
+  }
+#elif defined(FRUSTUM_SSE)
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 cx = _mm_loadu_ps(x + i);
+    const __m128 cy = _mm_loadu_ps(y + i);
+    const __m128 cz = _mm_loadu_ps(z + i);
+    const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+    __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+    for (const glm::vec4 &plane : m_planes)
+    {
+      const __m128 distance = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+        _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+    }
+
+    written += append_visible((uint32_t)_mm_movemask_ps(inside), (uint32_t)i, visible + written);
+  }
+#endif
+
+  for (; i < count; ++i)
+    if (intersects(glm::vec3(x[i], y[i], z[i]), radius[i]))
+      visible[written++] = (uint32_t)i;
+
+  return written;
+}
+
+size_t Frustum::cull(const BoundingBoxes &boxes, uint32_t *visible) const
+{
+  // the corner tested against each plane only depends on the plane, pick its arrays once
+  const float *cornerX[6];
+  const float *cornerY[6];
+  const float *cornerZ[6];
+  for (size_t p = 0; p < m_planes.size(); ++p)
+  {
+    cornerX[p] = m_planes[p].x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+    cornerY[p] = m_planes[p].y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+    cornerZ[p] = m_planes[p].z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+  }
+
+  const size_t count = boxes.size();
+  size_t written = 0;
+  size_t i = 0;
+
+#if defined(FRUSTUM_AVX)
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (size_t p = 0; p < m_planes.size(); ++p)
+    {
+      const glm::vec4 &plane = m_planes[p];
+      const __m256 distance = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(cornerX[p] + i), _mm256_set1_ps(plane.x)),
+                      _mm256_mul_ps(_mm256_loadu_ps(cornerY[p] + i), _mm256_set1_ps(plane.y))),
+        _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(cornerZ[p] + i), _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    written += append_visible((uint32_t)_mm256_movemask_ps(inside), (uint32_t)i, visible + written);
+  }
+#elif defined(FRUSTUM_SSE)
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+    for (size_t p = 0; p < m_planes.size(); ++p)
+    {
+      const glm::vec4 &plane = m_planes[p];
+      const __m128 distance = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(cornerX[p] + i), _mm_set1_ps(plane.x)),
+                   _mm_mul_ps(_mm_loadu_ps(cornerY[p] + i), _mm_set1_ps(plane.y))),
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(cornerZ[p] + i), _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+
+    written += append_visible((uint32_t)_mm_movemask_ps(inside), (uint32_t)i, visible + written);
+  }
+#endif
+
+  for (; i < count; ++i)
+  {
+    const glm::vec3 min = { boxes.minX[i], boxes.minY[i], boxes.minZ[i] };
+    const glm::vec3 max = { boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i] };
+
+    if (intersects(min, max))
+      visible[written++] = (uint32_t)i;
+  }
+
+  return written;
+}
@@ -0,0 +1,110 @@
+#include "Input.hpp"
+
+Input::Input(uint32_t capacity) : m_events(capacity) {}
+
+void Input::key(int key, int action, int mods)
+{
+  push({ Event::Type::key, key, action, mods });
+}
+
+void Input::button(int button, int action, int mods)
+{
+  push({ Event::Type::button, button, action, mods });
+}
+
+void Input::cursor(double x, double y)
+{
+  push({ Event::Type::cursor, 0, 0, 0, { x, y } });
+}
+
+void Input::scroll(double x, double y)
+{
+  push({ Event::Type::scroll, 0, 0, 0, { x, y } });
+}
+
+void Input::warp(double x, double y)
+{
+  push({ Event::Type::warp, 0, 0, 0, { x, y } });
+}
+
+void Input::grab(bool grabbed)
+{
+  push({ Event::Type::grab, 0, grabbed ? 1 : 0 });
+}
+
+void Input::push(const Event &event)
+{
+  if (!m_events.push(event))
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+const InputState &Input::update()
+{
+  if (m_events.empty())
+    return m_state;
+
+  Event event;
+  while (m_events.pop(event))
+    apply(m_state, event);
+
+  m_published.back() = m_state;
+  m_published.publish();
+  return m_state;
+}
+
+const InputState &Input::latest()
+{
+  m_published.acquire();
+  return m_published.front();
+}
+
+void Input::apply(InputState &state, const Event &event)
+{
+  switch (event.type)
+  {
+  case Event::Type::key:
+    if (event.code < 0 || event.code >= InputState::KEYS)
+      break;
+
+    state.mods = event.mods;
+    if (event.action == GLFW_PRESS)
+    {
+      state.keys.set(event.code);
+      ++state.keyPresses[event.code];
+    }
+    else if (event.action == GLFW_RELEASE)
+      state.keys.reset(event.code);
+    break;
+
+  case Event::Type::button:
+    if (event.code < 0 || event.code >= InputState::BUTTONS)
+      break;
+
+    state.mods = event.mods;
+    if (event.action == GLFW_PRESS)
+    {
+      state.buttons.set(event.code);
+      ++state.buttonPresses[event.code];
+    }
+    else if (event.action == GLFW_RELEASE)
+      state.buttons.reset(event.code);
+    break;
+
+  case Event::Type::cursor:
+    state.motion += event.value - state.cursor;
+    state.cursor = event.value;
+    break;
+
+  case Event::Type::warp:
+    state.cursor = event.value;
+    break;
+
+  case Event::Type::scroll:
+    state.scrolled += event.value;
+    break;
+
+  case Event::Type::grab:
+    state.grabbed = (event.action != 0);
+    break;
+  }
+}
@@ -0,0 +1,307 @@
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "FrameArena.hpp"
+
+#include <string>
+#include <algorithm>
+
+// identifies the queue owned by the current thread, external threads share queue 0
+static thread_local const JobSystem *t_system = nullptr;
+static thread_local uint32_t t_queue = 0;
+
+void JobSystem::start(uint32_t workerCount)
+{
+  if (m_running)
+    return;
+
+  if (workerCount == 0)
+    workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+  for (uint32_t i = 0; i <= workerCount; ++i)
+    m_queues.emplace_back(std::make_unique<Queue>());
+
+  m_running = true;
+  for (uint32_t i = 1; i <= workerCount; ++i)
+    m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::stop()
+{
+  if (!m_running.exchange(false))
+    return;
+
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_all();
+
+  for (std::thread &worker : m_workers)
+    worker.join();
+
+  m_workers.clear();
+  m_queues.clear();
+}
+
+void JobSystem::wait(const Handle &job)
+{
+  if (!job)
+    return;
+
+  while (!job->finished.load(std::memory_order_acquire))
+  {
+    if (executeOne())
+      continue;
+
+    // nothing left to help with, the remaining work is already running on a worker
+    if (m_workers.empty())
+      std::this_thread::yield();
+    else
+      job->finished.wait(false, std::memory_order_acquire);
+  }
+}
+
+
+JobSystem::Handle::Handle(const Handle &other) : m_job(other.m_job)
+{
+  if (m_job)
+    m_job->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+JobSystem::Handle &JobSystem::Handle::operator=(Handle other) noexcept
+{
+  std::swap(m_job, other.m_job);
+  return *this;
+}
+
+void JobSystem::Handle::reset()
+{
+  if (m_job && m_job->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    m_job->system->recycle(m_job);
+  m_job = nullptr;
+}
+
+template <typename T>
+T *JobSystem::Pool<T>::acquire()
+{
+  std::lock_guard guard(lock);
+
+  if (!free)
+  {
+    blocks.emplace_back(std::make_unique<T[]>(BLOCK_SIZE));
+
+    T *block = blocks.back().get();
+    for (uint32_t i = 0; i + 1 < BLOCK_SIZE; ++i)
+      block[i].next = &block[i + 1];
+    free = block;
+  }
+
+  T *node = free;
+  free = node->next;
+  node->next = nullptr;
+  return node;
+}
+
+template <typename T>
+void JobSystem::Pool<T>::release(T *first, T *last)
+{
+  std::lock_guard guard(lock);
+  last->next = free;
+  free = first;
+}
+
+JobSystem::Handle JobSystem::create()
+{
+  Job *job = m_jobs.acquire();
+
+  job->system = this;
+  job->references.store(1, std::memory_order_relaxed);
+  return Handle(job);
+}
+
+void JobSystem::recycle(Job *job)
+{
+  if (job->destroy)
+    job->destroy(*job);
+
+  // only left when the job never ran, dropped by stop()
+  recycle(std::exchange(job->continuations, nullptr));
+
+  job->run = nullptr;
+  job->destroy = nullptr;
+  job->owner = nullptr;
+  job->dependencies.store(1, std::memory_order_relaxed);
+  job->finished.store(false, std::memory_order_relaxed);
+
+  m_jobs.release(job, job);
+}
+
+void JobSystem::recycle(Link *links)
+{
+  if (!links)
+    return;
+
+  Link *last = links;
+  for (Link *link = links; link; link = link->next)
+  {
+    link->job.reset();
+    last = link;
+  }
+
+  m_links.release(links, last);
+}
+
+void JobSystem::depend(const Handle &job, const Handle &dependency)
+{
+  if (!dependency)
+    return;
+
+  std::lock_guard guard(dependency->lock);
+  if (dependency->finished.load(std::memory_order_relaxed))
+    return;
+
+  Link *link = m_links.acquire();
+  link->job = job;
+  link->next = dependency->continuations;
+
+  job->dependencies.fetch_add(1, std::memory_order_relaxed);
+  dependency->continuations = link;
+}
+
+void JobSystem::release(const Handle &job)
+{
+  if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    push(job);
+}
+
+void JobSystem::push(Handle job)
+{
+  // not started, behave like a synchronous call
+  if (m_queues.empty())
+    return execute(job);
+
+  Queue &queue = *m_queues[queueIndex()];
+  {
+    std::lock_guard guard(queue.lock);
+    queue.push_back(std::move(job));
+  }
+
+  m_signal.fetch_add(1, std::memory_order_release);
+  m_signal.notify_one();
+}
+
+JobSystem::Handle JobSystem::pop(uint32_t index)
+{
+  Queue &queue = *m_queues[index];
+  std::lock_guard guard(queue.lock);
+  return queue.pop_back();
+}
+
+JobSystem::Handle JobSystem::steal(uint32_t index)
+{
+  Queue &queue = *m_queues[index];
+  std::lock_guard guard(queue.lock);
+  return queue.pop_front();
+}
+
+void JobSystem::Queue::push_back(Handle job)
+{
+  if (count == jobs.size())
+  {
+    // unrolled into a ring twice as large, oldest job first
+    std::vector<Handle> grown(std::max<size_t>(64, jobs.size() * 2));
+    for (size_t i = 0; i < count; ++i)
+      grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+
+    jobs.swap(grown);
+    head = 0;
+  }
+
+  jobs[(head + count) % jobs.size()] = std::move(job);
+  ++count;
+}
+
+JobSystem::Handle JobSystem::Queue::pop_back()
+{
+  if (count == 0)
+    return nullptr;
+
+  --count;
+  return std::move(jobs[(head + count) % jobs.size()]);
+}
+
+JobSystem::Handle JobSystem::Queue::pop_front()
+{
+  if (count == 0)
+    return nullptr;
+
+  Handle job = std::move(jobs[head]);
+  head = (head + 1) % jobs.size();
+  --count;
+  return job;
+}
+
+bool JobSystem::executeOne()
+{
+  if (m_queues.empty())
+    return false;
+
+  const uint32_t own = queueIndex();
+  const uint32_t queues = (uint32_t)m_queues.size();
+
+  // newest local job first for cache locality, then the oldest job of the other queues
+  Handle job = pop(own);
+  for (uint32_t i = 1; !job && i < queues; ++i)
+    job = steal((own + i) % queues);
+
+  if (!job)
+    return false;
+
+  execute(job);
+  return true;
+}
+
+void JobSystem::execute(const Handle &job)
+{
+  if (job->run)
+  {
+    PROFILE_SCOPE("job");
+    job->run(*job.m_job);
+  }
+
+  Link *continuations;
+  {
+    std::lock_guard guard(job->lock);
+    job->finished.store(true, std::memory_order_release);
+    continuations = std::exchange(job->continuations, nullptr);
+  }
+  job->finished.notify_all();
+
+  for (Link *link = continuations; link; link = link->next)
+    release(link->job);
+  recycle(continuations);
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+  t_system = this;
+  t_queue = index;
+
+  Profiler::setThreadName("worker " + std::to_string(index));
+
+  while (m_running.load(std::memory_order_acquire))
+  {
+    // read the signal before looking for work so a push in between can't be missed
+    const uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+    // a job's scratch goes away with it
+    if (executeOne())
+      FrameArena::local().reset();
+    else
+      m_signal.wait(signal, std::memory_order_acquire);
+  }
+
+  t_system = nullptr;
+}
+
+uint32_t JobSystem::queueIndex() const
+{
+  return t_system == this ? t_queue : 0;
+}
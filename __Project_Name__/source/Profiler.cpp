@@ -0,0 +1,469 @@
+#include "Profiler.hpp"
+#include "FrameArena.hpp"
+#include "AllocationTracker.hpp"
+
+#include <imgui.h>
+
+#include <cfloat>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <string_view>
+
+namespace chrono = std::chrono;
+
+static float to_ms(Profiler::clock::rep ticks)
+{
+  return chrono::duration<float, std::milli>(Profiler::clock::duration(ticks)).count();
+}
+
+static int64_t now_ns()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(Profiler::clock::now().time_since_epoch()).count();
+}
+
+static ImU32 zone_color(const char *name)
+{
+  // stable color per zone name, muted enough for white text to stay readable
+  uint32_t hash = 2166136261u;
+  for (const char *c = name; *c; ++c)
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+  return IM_COL32(60 + (hash & 0x7F), 60 + ((hash >> 8) & 0x7F), 60 + ((hash >> 16) & 0x7F), 255);
+}
+
+Profiler &Profiler::get()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::setThreadName(const std::string &name)
+{
+  ThreadData &thread = local();
+  Profiler &profiler = get();
+
+  std::lock_guard guard(profiler.m_threadsLock);
+  thread.name = name;
+
+  AllocationTracker::setThreadName(name.c_str());
+}
+
+Profiler::ThreadData &Profiler::local()
+{
+  static thread_local ThreadData *thread = nullptr;
+
+  if (!thread)
+  {
+    Profiler &profiler = get();
+    std::lock_guard guard(profiler.m_threadsLock);
+
+    const uint32_t id = (uint32_t)profiler.m_threads.size();
+    profiler.m_threads.push_back(std::make_unique<ThreadData>(id));
+
+    thread = profiler.m_threads.back().get();
+    thread->name = "thread " + std::to_string(id);
+  }
+  return *thread;
+}
+
+uint32_t Profiler::enter()
+{
+  return local().depth++;
+}
+
+void Profiler::leave(const char *name, uint32_t depth, clock::time_point begin, clock::time_point end)
+{
+  ThreadData &thread = local();
+
+  thread.depth = depth;
+  if (!thread.zones.push({ name, begin.time_since_epoch().count(), end.time_since_epoch().count(), thread.id, depth }))
+    thread.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void Profiler::beginFrame()
+{
+  std::lock_guard lock(m_historyLock);
+
+  m_recording = !m_paused;
+  if (!m_recording)
+    return;
+
+  Frame &current = frame(m_frameIndex);
+  current.begin = clock::now().time_since_epoch().count();
+  current.end = 0;
+  current.firstZone = m_zonesTrimmed + m_zones.size();
+
+  // this slot was recorded GPU_LATENCY frames ago, its queries are done by now
+  GpuFrame &gpu = m_gpuFrames[m_frameIndex % GPU_LATENCY];
+  collectGpu(gpu);
+
+  gpu.zones.clear();
+  gpu.open.clear();
+
+  GLint64 gpuNow = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+  gpu.offset = now_ns() - gpuNow;
+}
+
+void Profiler::endFrame()
+{
+  std::lock_guard lock(m_historyLock);
+
+  collect();
+
+  if (!m_recording)
+    return;
+
+  frame(m_frameIndex).end = clock::now().time_since_epoch().count();
+  trim();
+  ++m_frameIndex;
+}
+
+void Profiler::beginGpu(const char *name)
+{
+  if (!m_recording)
+    return;
+
+  GpuFrame &gpu = m_gpuFrames[m_frameIndex % GPU_LATENCY];
+  const uint32_t index = (uint32_t)gpu.zones.size();
+
+  if (gpu.queries.size() < (index + 1) * 2)
+  {
+    gpu.queries.resize((index + 1) * 2);
+    glGenQueries(2, &gpu.queries[index * 2]);
+  }
+
+  glQueryCounter(gpu.queries[index * 2], GL_TIMESTAMP);
+  gpu.zones.push_back({ name, (uint32_t)gpu.open.size() });
+  gpu.open.push_back(index);
+}
+
+void Profiler::endGpu()
+{
+  GpuFrame &gpu = m_gpuFrames[m_frameIndex % GPU_LATENCY];
+  if (!m_recording || gpu.open.empty())
+    return;
+
+  glQueryCounter(gpu.queries[gpu.open.back() * 2 + 1], GL_TIMESTAMP);
+  gpu.open.pop_back();
+}
+
+void Profiler::shutdown()
+{
+  for (GpuFrame &gpu : m_gpuFrames)
+  {
+    if (!gpu.queries.empty())
+      glDeleteQueries((GLsizei)gpu.queries.size(), gpu.queries.data());
+
+    gpu.queries.clear();
+    gpu.zones.clear();
+    gpu.open.clear();
+  }
+}
+
+
+void Profiler::collect()
+{
+  std::lock_guard guard(m_threadsLock);
+
+  Zone zone;
+  for (const std::unique_ptr<ThreadData> &thread : m_threads)
+  {
+    // drained even while paused so the rings never fill up
+    while (thread->zones.pop(zone))
+      if (m_recording)
+        m_zones.push_back(zone);
+  }
+}
+
+void Profiler::collectGpu(GpuFrame &gpu)
+{
+  if (gpu.zones.empty() || !gpu.open.empty())
+    return;
+
+  // never stall on the driver: a frame whose results aren't ready is dropped
+  GLint available = 0;
+  glGetQueryObjectiv(gpu.queries[gpu.zones.size() * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return;
+
+  const auto to_clock = [&gpu](GLuint64 timestamp) {
+    return chrono::duration_cast<clock::duration>(chrono::nanoseconds((int64_t)timestamp + gpu.offset)).count();
+  };
+
+  for (size_t i = 0; i < gpu.zones.size(); ++i)
+  {
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+
+    glGetQueryObjectui64v(gpu.queries[i * 2], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(gpu.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+    m_zones.push_back({ gpu.zones[i].name, to_clock(begin), to_clock(end), GPU_THREAD, gpu.zones[i].depth });
+  }
+}
+
+void Profiler::trim()
+{
+  if (m_frameIndex + 1 < HISTORY)
+    return;
+
+  // the next frame overwrites the oldest slot, its zones go with it
+  const uint64_t first = frame(m_frameIndex + 1).firstZone;
+  while (m_zonesTrimmed < first && !m_zones.empty())
+  {
+    m_zones.pop_front();
+    ++m_zonesTrimmed;
+  }
+}
+
+
+void Profiler::drawUi(bool *open)
+{
+  if (!ImGui::Begin("Profiler", open))
+  {
+    ImGui::End();
+    return;
+  }
+
+  std::lock_guard lock(m_historyLock);
+
+  ImGui::Checkbox("Pause", &m_paused);
+  ImGui::SameLine();
+  if (ImGui::Button("Export Chrome trace"))
+    exportChromeTrace("profile.json");
+
+  // GPU results lag behind, show the newest frame that has all of them
+  if (m_frameIndex > GPU_LATENCY)
+  {
+    const Frame &shown = frame(m_frameIndex - GPU_LATENCY - 1);
+
+    ImGui::Text("Frame %llu: %.3f ms", (unsigned long long)(m_frameIndex - GPU_LATENCY - 1), to_ms(shown.end - shown.begin));
+    drawFlameGraph(shown);
+    drawHistograms();
+    drawPhases(shown);
+  }
+
+  ImGui::End();
+}
+
+void Profiler::drawFlameGraph(const Frame &shown)
+{
+  constexpr float BAR_HEIGHT = 18.0f;
+  constexpr float LABEL_WIDTH = 90.0f;
+
+  const clock::rep duration = shown.end - shown.begin;
+  if (duration <= 0)
+    return;
+
+  std::lock_guard guard(m_threadsLock);
+
+  // ui scratch, gone with the frame
+  FrameArena &arena = FrameArena::local();
+  const uint64_t first = std::max(shown.firstZone, m_zonesTrimmed);
+  const uint64_t last = m_zonesTrimmed + m_zones.size();
+
+  // one row per thread, the GPU last, each as tall as its deepest zone
+  const size_t gpuRow = m_threads.size();
+  const std::span<uint32_t> depths = arena.array<uint32_t>(gpuRow + 1);
+  const std::span<const Zone *> zones = arena.array<const Zone *>(last > first ? last - first : 0);
+  size_t zoneCount = 0;
+
+  for (uint64_t i = first; i < last; ++i)
+  {
+    const Zone &zone = m_zones[i - m_zonesTrimmed];
+    if (zone.end < shown.begin || zone.begin > shown.end)
+      continue;
+
+    const size_t row = (zone.thread == GPU_THREAD) ? gpuRow : zone.thread;
+    depths[row] = std::max(depths[row], zone.depth + 1);
+    zones[zoneCount++] = &zone;
+  }
+
+  const std::span<float> rowOffsets = arena.array<float>(gpuRow + 2);
+  for (size_t row = 0; row <= gpuRow; ++row)
+    rowOffsets[row + 1] = rowOffsets[row] + depths[row] * BAR_HEIGHT;
+
+  ImDrawList *draw = ImGui::GetWindowDrawList();
+  const ImVec2 origin = ImGui::GetCursorScreenPos();
+  const float width = std::max(ImGui::GetContentRegionAvail().x - LABEL_WIDTH, 100.0f);
+
+  for (size_t row = 0; row <= gpuRow; ++row)
+  {
+    if (depths[row] == 0)
+      continue;
+
+    const char *label = (row == gpuRow) ? "GPU" : m_threads[row]->name.c_str();
+    draw->AddText(ImVec2(origin.x, origin.y + rowOffsets[row]), IM_COL32(200, 200, 200, 255), label);
+  }
+
+  for (const Zone *zone : zones.first(zoneCount))
+  {
+    const size_t row = (zone->thread == GPU_THREAD) ? gpuRow : zone->thread;
+    const float x0 = (std::max(zone->begin, shown.begin) - shown.begin) / (float)duration * width;
+    const float x1 = (std::min(zone->end, shown.end) - shown.begin) / (float)duration * width;
+
+    const ImVec2 min(origin.x + LABEL_WIDTH + x0, origin.y + rowOffsets[row] + zone->depth * BAR_HEIGHT);
+    const ImVec2 max(origin.x + LABEL_WIDTH + std::max(x1, x0 + 1.0f), min.y + BAR_HEIGHT - 1.0f);
+
+    draw->AddRectFilled(min, max, zone_color(zone->name));
+    if (max.x - min.x > 20.0f)
+    {
+      draw->PushClipRect(min, max, true);
+      draw->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(255, 255, 255, 255), zone->name);
+      draw->PopClipRect();
+    }
+
+    if (ImGui::IsMouseHoveringRect(min, max))
+      ImGui::SetTooltip("%s: %.3f ms", zone->name, to_ms(zone->end - zone->begin));
+  }
+
+  ImGui::Dummy(ImVec2(LABEL_WIDTH + width, rowOffsets.back()));
+}
+
+void Profiler::drawHistograms()
+{
+  constexpr int BUCKETS = 40;
+
+  // completed frames, oldest first
+  const uint32_t count = (uint32_t)std::min<uint64_t>(m_frameIndex, HISTORY - 1);
+
+  float times[HISTORY];
+  float longest = 0.0f;
+  float total = 0.0f;
+
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const Frame &past = frame(m_frameIndex - count + i);
+
+    times[i] = to_ms(past.end - past.begin);
+    longest = std::max(longest, times[i]);
+    total += times[i];
+  }
+
+  if (count == 0)
+    return;
+
+  // frames too short for the clock all land in the first bucket
+  float buckets[BUCKETS] = {};
+  for (uint32_t i = 0; i < count; ++i)
+    buckets[longest > 0.0f ? std::min(BUCKETS - 1, (int)(times[i] / longest * BUCKETS)) : 0] += 1.0f;
+
+  ImGui::Text("Last %u frames: avg %.3f ms, max %.3f ms", count, total / count, longest);
+  ImGui::PlotHistogram("Frame times", times, (int)count, 0, nullptr, 0.0f, longest, ImVec2(0, 80));
+  ImGui::PlotHistogram("Distribution", buckets, BUCKETS, 0, "0 ms .. max", 0.0f, FLT_MAX, ImVec2(0, 80));
+}
+
+void Profiler::drawPhases(const Frame &shown)
+{
+  struct Phase
+  {
+    const char *name;
+    uint32_t thread;
+    clock::rep total;
+  };
+
+  const uint64_t first = std::max(shown.firstZone, m_zonesTrimmed);
+  const uint64_t last = m_zonesTrimmed + m_zones.size();
+
+  // at most one phase per zone, ui scratch gone with the frame
+  const std::span<Phase> storage = FrameArena::local().array<Phase>(last > first ? last - first : 0);
+  size_t phaseCount = 0;
+
+  for (uint64_t i = first; i < last; ++i)
+  {
+    const Zone &zone = m_zones[i - m_zonesTrimmed];
+    if (zone.end < shown.begin || zone.begin > shown.end)
+      continue;
+
+    const std::span<Phase> found = storage.first(phaseCount);
+    auto it = std::find_if(found.begin(), found.end(), [&zone](const Phase &phase) {
+      return phase.name == zone.name && phase.thread == zone.thread;
+    });
+
+    if (it == found.end())
+      storage[phaseCount++] = { zone.name, zone.thread, zone.end - zone.begin };
+    else
+      it->total += zone.end - zone.begin;
+  }
+
+  const std::span<const Phase> phases = storage.first(phaseCount);
+
+  if (!ImGui::BeginTable("phases", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    return;
+
+  ImGui::TableSetupColumn("Zone");
+  ImGui::TableSetupColumn("Thread");
+  ImGui::TableSetupColumn("ms");
+  ImGui::TableHeadersRow();
+
+  std::lock_guard guard(m_threadsLock);
+  for (const Phase &phase : phases)
+  {
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted(phase.name);
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted(phase.thread == GPU_THREAD ? "GPU" : m_threads[phase.thread]->name.c_str());
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f", to_ms(phase.total));
+  }
+
+  ImGui::EndTable();
+}
+
+// quoted, with what JSON doesn't allow as is escaped
+static void write_json_string(std::ostream &os, std::string_view text)
+{
+  os << '"';
+  for (const char c : text)
+  {
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)(unsigned char)c);
+      os << escaped;
+    }
+    else
+      os << c;
+  }
+  os << '"';
+}
+
+bool Profiler::exportChromeTrace(const std::filesystem::path &path) const
+{
+  std::ofstream ofs(path);
+  if (!ofs)
+    return false;
+
+  const auto us = [](clock::rep ticks) { return chrono::duration<double, std::micro>(clock::duration(ticks)).count(); };
+  const auto tid = [](uint32_t thread) { return thread == GPU_THREAD ? -1 : (int64_t)thread; };
+
+  ofs << "{\"traceEvents\":[\n";
+  ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":-1,\"args\":{\"name\":\"GPU\"}}";
+  {
+    std::lock_guard guard(m_threadsLock);
+    for (const std::unique_ptr<ThreadData> &thread : m_threads)
+    {
+      ofs << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->id << ",\"args\":{\"name\":";
+      write_json_string(ofs, thread->name);
+      ofs << "}}";
+    }
+  }
+
+  ofs.precision(3);
+  ofs << std::fixed;
+  for (const Zone &zone : m_zones)
+  {
+    ofs << ",\n{\"name\":";
+    write_json_string(ofs, zone.name);
+    ofs << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid(zone.thread)
+      << ",\"ts\":" << us(zone.begin) << ",\"dur\":" << us(zone.end - zone.begin) << "}";
+  }
+
+  ofs << "\n]}\n";
+  return ofs.good();
+}
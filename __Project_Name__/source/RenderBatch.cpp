@@ -0,0 +1,209 @@
+#include "RenderBatch.hpp"
+#include "Profiler.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <algorithm>
+
+bool RenderBatch::create(uint32_t maxInstances)
+{
+  destroy();
+
+  m_capacity = maxInstances;
+  m_indirect = glMultiDrawArraysIndirect != nullptr && glMultiDrawElementsIndirect != nullptr;
+
+  bool created = m_instanceStream.create(sizeof(Instance) * maxInstances, 16);
+  if (m_indirect)
+    created &= m_commandStream.create(sizeof(IndirectCommand) * maxInstances, 4);
+
+  return created;
+}
+
+void RenderBatch::destroy()
+{
+  m_instanceStream.destroy();
+  m_commandStream.destroy();
+
+  m_meshes.clear();
+  m_instances.clear();
+  m_draws.clear();
+}
+
+uint32_t RenderBatch::addMesh(const Mesh &mesh)
+{
+  glBindVertexArray(mesh.vertexArray);
+
+  // only the divisors live in the vertex array, the pointers follow the stream every flush
+  for (GLuint location = MODEL_LOCATION; location < MODEL_LOCATION + 4; ++location)
+  {
+    glEnableVertexAttribArray(location);
+    glVertexAttribDivisor(location, 1);
+  }
+  glEnableVertexAttribArray(TINT_LOCATION);
+  glVertexAttribDivisor(TINT_LOCATION, 1);
+
+  glBindVertexArray(0);
+
+  m_meshes.push_back(mesh);
+  return (uint32_t)m_meshes.size() - 1;
+}
+
+void RenderBatch::submit(const Shader &shader, uint32_t mesh, const Instance &instance, uint8_t layer)
+{
+  const GLuint program = shader.id();
+  if (!program || mesh >= m_meshes.size())
+    return;
+
+  m_draws.push_back({ DrawKey::make(layer, program, m_meshes[mesh].vertexArray, (uint16_t)mesh), program, mesh, (uint32_t)m_instances.size() });
+  m_instances.push_back(instance);
+}
+
+void RenderBatch::flush()
+{
+  m_drawCalls = 0;
+  m_instanceCount = 0;
+
+  if (m_draws.empty() || !m_instanceStream.id())
+    return;
+
+  PROFILE_SCOPE("batch.flush");
+
+  std::sort(m_draws.begin(), m_draws.end(), [](const Draw &a, const Draw &b) { return a.key < b.key; });
+
+  if (m_draws.size() > m_capacity)
+  {
+    if (!m_warned)
+      std::cout << "RenderBatch: " << m_draws.size() << " instances submitted for " << m_capacity << " slots, the rest is dropped" << std::endl;
+    m_warned = true;
+    m_draws.resize(m_capacity);
+  }
+
+  // instances are streamed in draw order so every run reads a contiguous range
+  m_instanceStream.beginFrame();
+  const StreamingBuffer::Allocation instances = m_instanceStream.allocate(sizeof(Instance) * m_draws.size());
+
+  Instance *out = (Instance *)instances.data;
+  for (const Draw &draw : m_draws)
+    *out++ = m_instances[draw.instance];
+  m_instanceStream.flush();
+
+  m_runs.clear();
+  m_groups.clear();
+  for (uint32_t i = 0; i < m_draws.size(); ++i)
+  {
+    const Draw &draw = m_draws[i];
+
+    if (!m_runs.empty() && m_runs.back().program == draw.program && m_runs.back().mesh == draw.mesh)
+    {
+      ++m_runs.back().instanceCount;
+      continue;
+    }
+
+    const Mesh &mesh = m_meshes[draw.mesh];
+    const bool merge = !m_groups.empty() && m_runs.back().program == draw.program
+      && m_meshes[m_runs.back().mesh].vertexArray == mesh.vertexArray
+      && m_meshes[m_runs.back().mesh].mode == mesh.mode
+      && m_meshes[m_runs.back().mesh].indexType == mesh.indexType;
+
+    if (merge)
+      ++m_groups.back().runCount;
+    else
+      m_groups.push_back({ (uint32_t)m_runs.size(), 1 });
+
+    m_runs.push_back({ draw.program, draw.mesh, i, 1 });
+  }
+
+  StreamingBuffer::Allocation commands;
+  if (m_indirect)
+  {
+    m_commandStream.beginFrame();
+    commands = m_commandStream.allocate(sizeof(IndirectCommand) * m_runs.size());
+
+    IndirectCommand *command = (IndirectCommand *)commands.data;
+    for (const Group &group : m_groups)
+    {
+      // relative to the instance pointer of the group
+      const uint32_t base = m_runs[group.firstRun].firstInstance;
+
+      for (uint32_t r = group.firstRun; r < group.firstRun + group.runCount; ++r)
+      {
+        const Run &run = m_runs[r];
+        const Mesh &mesh = m_meshes[run.mesh];
+
+        if (mesh.indexType)
+          *command++ = { (GLuint)mesh.count, run.instanceCount, mesh.first, mesh.baseVertex, run.firstInstance - base };
+        else
+          *command++ = { (GLuint)mesh.count, run.instanceCount, mesh.first, (GLint)(run.firstInstance - base), 0 };
+      }
+    }
+    m_commandStream.flush();
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandStream.id());
+  }
+
+  GLuint program = 0;
+  GLuint vertexArray = 0;
+  for (const Group &group : m_groups)
+  {
+    const Run &head = m_runs[group.firstRun];
+    const Mesh &mesh = m_meshes[head.mesh];
+
+    if (head.program != program)
+      glUseProgram(program = head.program);
+    if (mesh.vertexArray != vertexArray)
+      glBindVertexArray(vertexArray = mesh.vertexArray);
+
+    if (!m_indirect)
+    {
+      for (uint32_t r = group.firstRun; r < group.firstRun + group.runCount; ++r)
+        drawRun(m_runs[r], instances.offset);
+      continue;
+    }
+
+    pointInstances(instances.offset + sizeof(Instance) * head.firstInstance);
+
+    const void *offset = (const void *)(commands.offset + sizeof(IndirectCommand) * group.firstRun);
+    if (mesh.indexType)
+      glMultiDrawElementsIndirect(mesh.mode, mesh.indexType, offset, (GLsizei)group.runCount, sizeof(IndirectCommand));
+    else
+      glMultiDrawArraysIndirect(mesh.mode, offset, (GLsizei)group.runCount, sizeof(IndirectCommand));
+    ++m_drawCalls;
+  }
+
+  if (m_indirect)
+  {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    m_commandStream.endFrame();
+  }
+  m_instanceStream.endFrame();
+
+  m_instanceCount = (uint32_t)m_draws.size();
+  m_instances.clear();
+  m_draws.clear();
+}
+
+void RenderBatch::pointInstances(GLintptr offset) const
+{
+  glBindBuffer(GL_ARRAY_BUFFER, m_instanceStream.id());
+
+  for (GLuint column = 0; column < 4; ++column)
+  {
+    const GLintptr attribute = offset + offsetof(Instance, model) + sizeof(glm::vec4) * column;
+    glVertexAttribPointer(MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void *)attribute);
+  }
+  glVertexAttribPointer(TINT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void *)(offset + offsetof(Instance, tint)));
+}
+
+void RenderBatch::drawRun(const Run &run, GLintptr instances) const
+{
+  const Mesh &mesh = m_meshes[run.mesh];
+
+  pointInstances(instances + sizeof(Instance) * run.firstInstance);
+
+  if (!mesh.indexType)
+    return (void)glDrawArraysInstanced(mesh.mode, (GLint)mesh.first, mesh.count, (GLsizei)run.instanceCount);
+
+  const size_t indexSize = mesh.indexType == GL_UNSIGNED_INT ? 4 : mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 1;
+  glDrawElementsInstancedBaseVertex(mesh.mode, mesh.count, mesh.indexType, (const void *)(indexSize * mesh.first),
+                                    (GLsizei)run.instanceCount, mesh.baseVertex);
+}
@@ -1,9 +1,39 @@
 #include "Shader.hpp"
+#include "Hash.hpp"
+#include "JobSystem.hpp"
 
 #include <vector>
+#include <cstring>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <iostream>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 
+// glad may be generated without GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool parallel_compile_supported()
+{
+  static const bool supported = []() {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+      const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+      if (name && (!strcmp(name, "GL_KHR_parallel_shader_compile") || !strcmp(name, "GL_ARB_parallel_shader_compile")))
+        return true;
+    }
+    return false;
+  }();
+
+  return supported;
+}
 
 static constexpr std::string_view default_vertex = R"(
   #version 110
@@ -27,6 +57,34 @@ static constexpr std::string_view default_fragment = R"(
 )";
 
 Shader Shader::default_shader;
+std::filesystem::path Shader::cache_directory = "shader_cache";
+JobSystem *Shader::cache_writer = nullptr;
+std::vector<std::filesystem::path> Shader::include_directories;
+
+// included files by normalized path, shared by every shader and the reload thread
+static std::mutex include_lock;
+static std::unordered_map<std::string, std::string> include_cache;
+
+// hashed from the GL strings by the first build, threads without a context read it back for their cache keys
+static std::atomic<uint64_t> driver_key = 0;
+
+static uint64_t driver_hash()
+{
+  uint64_t key = driver_key.load(std::memory_order_relaxed);
+  if (key)
+    return key;
+
+  // a driver update or another GPU invalidates every binary
+  key = FNV1A_OFFSET;
+  for (const GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+  {
+    const char *value = (const char *)glGetString(name);
+    key = fnv1a(value ? value : "", key);
+  }
+
+  driver_key.store(key, std::memory_order_relaxed);
+  return key;
+}
 
 const Shader &Shader::getDefaultShader()
 {
@@ -49,30 +107,70 @@ Shader::Shader() noexcept : m_valid(false), m_program(0) {}
 Shader::Shader(Shader &&mv) noexcept :
   m_valid(mv.m_valid),
   m_program(mv.m_program),
+  m_building(mv.m_building),
+  m_buildKey(mv.m_buildKey),
+  m_buildCached(mv.m_buildCached),
+  m_sources(std::move(mv.m_sources)),
+  m_files(std::move(mv.m_files)),
+  m_includes(std::move(mv.m_includes)),
+  m_defines(std::move(mv.m_defines)),
   m_shaders(std::move(mv.m_shaders)),
   m_uniforms(std::move(mv.m_uniforms)),
-  m_attributes(std::move(mv.m_attributes))
+  m_attributes(std::move(mv.m_attributes)),
+  m_blocks(std::move(mv.m_blocks)),
+  m_offsets(std::move(mv.m_offsets)),
+  m_blockSizes(std::move(mv.m_blockSizes)),
+  m_blockBindings(std::move(mv.m_blockBindings))
 {
   mv.m_valid = false;
   mv.m_program = 0;
+  mv.m_building = 0;
+  mv.m_sources.clear();
+  mv.m_files.clear();
+  mv.m_includes.clear();
+  mv.m_defines.clear();
   mv.m_shaders.clear();
   mv.m_uniforms.clear();
   mv.m_attributes.clear();
+  mv.m_blocks.clear();
+  mv.m_offsets.clear();
+  mv.m_blockSizes.clear();
+  mv.m_blockBindings.clear();
 }
 
 Shader &Shader::operator=(Shader &&other) noexcept
 {
   m_valid = other.m_valid;
   m_program = other.m_program;
+  m_building = other.m_building;
+  m_buildKey = other.m_buildKey;
+  m_buildCached = other.m_buildCached;
+  m_sources = std::move(other.m_sources);
+  m_files = std::move(other.m_files);
+  m_includes = std::move(other.m_includes);
+  m_defines = std::move(other.m_defines);
   m_shaders = std::move(other.m_shaders);
   m_uniforms = std::move(other.m_uniforms);
   m_attributes = std::move(other.m_attributes);
+  m_blocks = std::move(other.m_blocks);
+  m_offsets = std::move(other.m_offsets);
+  m_blockSizes = std::move(other.m_blockSizes);
+  m_blockBindings = std::move(other.m_blockBindings);
 
   other.m_valid = false;
   other.m_program = 0;
+  other.m_building = 0;
+  other.m_sources.clear();
+  other.m_files.clear();
+  other.m_includes.clear();
+  other.m_defines.clear();
   other.m_shaders.clear();
   other.m_uniforms.clear();
   other.m_attributes.clear();
+  other.m_blocks.clear();
+  other.m_offsets.clear();
+  other.m_blockSizes.clear();
+  other.m_blockBindings.clear();
 
   return *this;
 }
@@ -80,55 +178,34 @@ Shader &Shader::operator=(Shader &&other) noexcept
 
 bool Shader::addSource(Type type, const std::vector<std::string_view> &source)
 {
-  GLuint shaderId = getOrCreate(type);
+  std::string &code = m_sources[type];
 
-  // compile the source code
-  const char **src = new const char *[source.size() + 1];
+  code.clear();
+  for (const std::string_view &part : source)
+    code.append(part);
 
-  for (uint32_t i = 0; i < source.size(); ++i)
-    src[i] = source[i].data();
-  src[source.size()] = nullptr;
-
-  glShaderSource(shaderId, (GLsizei)source.size(), src, NULL);
-  glCompileShader(shaderId);
-
-  // error management
-  GLint result;
-  glGetShaderiv(shaderId, GL_COMPILE_STATUS, &result);
-  if (result != GL_TRUE)
-  {
-    getShaderErrors(shaderId);
-    return false;
-  }
-
-  m_valid = false;
-  return true;
+  return !code.empty();
 }
 
 
 bool Shader::addSource(Type type, const std::string_view &source)
 {
-  GLuint shaderId = getOrCreate(type);
+  m_sources[type] = source;
 
-  // compile the source code
-  const char *src = source.data();
-  glShaderSource(shaderId, 1, &src, NULL);
-  glCompileShader(shaderId);
+  return !source.empty();
+}
 
-  // error management
-  GLint result;
-  glGetShaderiv(shaderId, GL_COMPILE_STATUS, &result);
-  if (result != GL_TRUE)
-  {
-    getShaderErrors(shaderId);
+bool Shader::addFile(Type type, const std::filesystem::path &filePath)
+{
+  std::string source;
+  if (!readFile(filePath, source))
     return false;
-  }
 
-  m_valid = false;
-  return true;
+  m_files[type] = filePath;
+  return addSource(type, source);
 }
 
-bool Shader::addFile(Type type, const std::filesystem::path &filePath)
+bool Shader::readFile(const std::filesystem::path &filePath, std::string &source)
 {
   std::stringstream buffer;
 
@@ -149,11 +226,201 @@ bool Shader::addFile(Type type, const std::filesystem::path &filePath)
   buffer << ifs.rdbuf();
   ifs.close();
 
-  return addSource(type, buffer.str());
+  source = buffer.str();
+  return true;
+}
+
+void Shader::setDefines(const Defines &defines)
+{
+  m_defines = defines;
+}
+
+Shader Shader::permute(const Defines &defines) const
+{
+  Shader variant;
+
+  variant.m_sources = m_sources;
+  variant.m_files = m_files;
+  variant.m_defines = defines;
+  variant.m_blockBindings = m_blockBindings;
+  return variant;
+}
+
+uint64_t Shader::permutationHash(const Defines &defines, uint64_t seed)
+{
+  Defines sorted = defines;
+  std::sort(sorted.begin(), sorted.end());
+
+  for (const auto &[name, value] : sorted)
+  {
+    seed = fnv1a(name, seed);
+    seed = fnv1a("=", seed);
+    seed = fnv1a(value, seed);
+    seed = fnv1a("\n", seed);
+  }
+  return seed;
+}
+
+void Shader::addIncludeDirectory(const std::filesystem::path &directory)
+{
+  include_directories.push_back(directory);
+}
+
+void Shader::reloadInclude(const std::filesystem::path &file)
+{
+  std::string source;
+  if (!readFile(file, source))
+    return;
+
+  std::lock_guard guard(include_lock);
+  include_cache[file.lexically_normal().string()] = std::move(source);
+}
+
+static bool read_include(const std::filesystem::path &file, std::string &source)
+{
+  const std::string key = file.lexically_normal().string();
+  {
+    std::lock_guard guard(include_lock);
+
+    const auto it = include_cache.find(key);
+    if (it != include_cache.end())
+    {
+      source = it->second;
+      return true;
+    }
+  }
+
+  if (!Shader::readFile(file, source))
+    return false;
+
+  std::lock_guard guard(include_lock);
+  include_cache.emplace(key, source);
+  return true;
+}
+
+static bool find_include(const std::string_view name, const std::filesystem::path &origin, const std::vector<std::filesystem::path> &directories, std::filesystem::path &file)
+{
+  file = (origin.parent_path() / name).lexically_normal();
+  {
+    std::lock_guard guard(include_lock);
+    if (include_cache.contains(file.string()))
+      return true;
+  }
+  if (std::filesystem::exists(file))
+    return true;
+
+  for (const std::filesystem::path &directory : directories)
+  {
+    file = (directory / name).lexically_normal();
+    if (std::filesystem::exists(file))
+      return true;
+  }
+  return false;
+}
+
+// copies source into result with its includes expanded, #line directives keep the compiler logs pointing at the right file
+static bool expand_includes(std::string_view source, const std::filesystem::path &origin, size_t index,
+                            const std::vector<std::filesystem::path> &directories, std::vector<std::filesystem::path> &files, std::string &result)
+{
+  size_t line = 1;
+  for (size_t begin = 0; begin < source.size(); ++line)
+  {
+    size_t end = source.find('\n', begin);
+    if (end == std::string_view::npos)
+      end = source.size();
+
+    const std::string_view text = source.substr(begin, end - begin);
+    begin = end + 1;
+
+    const size_t directive = text.find_first_not_of(" \t");
+    if (directive == std::string_view::npos || !text.substr(directive).starts_with("#include"))
+    {
+      result.append(text);
+      result.push_back('\n');
+      continue;
+    }
+
+    const size_t open = text.find_first_of("\"<", directive);
+    const size_t close = open == std::string_view::npos ? open : text.find_first_of("\">", open + 1);
+    if (close == std::string_view::npos)
+    {
+      std::cout << "Shader preprocessor error: " << origin << ":" << line << ": malformed #include" << std::endl;
+      return false;
+    }
+
+    const std::string_view name = text.substr(open + 1, close - open - 1);
+
+    std::filesystem::path file;
+    if (!find_include(name, origin, directories, file))
+    {
+      std::cout << "Shader preprocessor error: " << origin << ":" << line << ": cannot find " << name << std::endl;
+      return false;
+    }
+
+    // included once per source, which also breaks include cycles
+    if (std::find(files.begin(), files.end(), file) != files.end())
+    {
+      result.push_back('\n');
+      continue;
+    }
+    files.push_back(file);
+
+    std::string included;
+    if (!read_include(file, included))
+      return false;
+
+    const size_t fileIndex = files.size();
+    result.append("#line 1 " + std::to_string(fileIndex) + "\n");
+    if (!expand_includes(included, file, fileIndex, directories, files, result))
+      return false;
+    result.append("#line " + std::to_string(line + 1) + " " + std::to_string(index) + "\n");
+  }
+  return true;
+}
+
+bool Shader::preprocess(std::string_view source, const std::filesystem::path &origin, const Defines &defines,
+                        std::string &result, std::vector<std::filesystem::path> &includes)
+{
+  std::vector<std::filesystem::path> files;
+
+  result.clear();
+  result.reserve(source.size());
+  if (!expand_includes(source, origin, 0, include_directories, files, result))
+    return false;
+
+  for (const std::filesystem::path &file : files)
+    if (std::find(includes.begin(), includes.end(), file) == includes.end())
+      includes.push_back(file);
+
+  if (defines.empty())
+    return true;
+
+  // #version has to stay the first directive, the defines go right after it
+  size_t position = 0;
+  size_t line = 1;
+  const size_t version = result.find("#version");
+  if (version != std::string::npos)
+  {
+    position = result.find('\n', version);
+    position = position == std::string::npos ? result.size() : position + 1;
+    line = std::count(result.begin(), result.begin() + position, '\n') + 1;
+  }
+
+  std::string injected;
+  for (const auto &[name, value] : defines)
+    injected += "#define " + name + " " + value + "\n";
+  injected += "#line " + std::to_string(line) + " 0\n";
+
+  result.insert(position, injected);
+  return true;
 }
 
 void Shader::remove(Type type)
 {
+  m_files.erase(type);
+  if (m_sources.erase(type))
+    m_valid = false;
+
   if (m_shaders.contains(type))
   {
     const GLuint shaderId = m_shaders.at(type);
@@ -174,43 +441,307 @@ void Shader::clear()
       glDeleteShader(shaderId);
 
   m_shaders.clear();
+  m_sources.clear();
+  m_files.clear();
+  m_includes.clear();
 
+  if (glIsProgram(m_building))
+    glDeleteProgram(m_building);
   if (glIsProgram(m_program))
     glDeleteProgram(m_program);
 
+  m_building = 0;
   m_program = 0;
   m_valid = false;
 }
 
 bool Shader::compile()
 {
-  if (!glIsProgram(m_program))
-    m_program = glCreateProgram();
+  return startBuild() && finishBuild();
+}
+
+bool Shader::compileAsync()
+{
+  return startBuild();
+}
+
+bool Shader::prepare(const std::map<Type, std::filesystem::path> &files, const Defines &defines, Prepared &prepared)
+{
+  for (const auto &[type, file] : files)
+  {
+    if (!readFile(file, prepared.sources[type]))
+      return false;
+    if (!preprocess(prepared.sources[type], file, defines, prepared.code[type], prepared.includes))
+      return false;
+  }
+
+  // unknown until the GL thread built something, compileAsync() computes the key then
+  const uint64_t driver = driver_key.load(std::memory_order_relaxed);
+  if (driver)
+  {
+    prepared.key = cacheKey(prepared.code, driver);
+    readBinary(prepared.key, prepared.format, prepared.binary);
+  }
+  return true;
+}
+
+bool Shader::compileAsync(Prepared &&prepared)
+{
+  for (auto &[type, source] : prepared.sources)
+    m_sources[type] = std::move(source);
+
+  // stages that weren't given as files have no disk access to spare
+  for (const auto &[type, source] : m_sources)
+    if (!prepared.code.contains(type) && !preprocess(source, {}, m_defines, prepared.code[type], prepared.includes))
+      return false;
+  m_includes = std::move(prepared.includes);
+
+  if (!prepared.key)
+    prepared.key = cacheKey(prepared.code, driver_hash());
+
+  return submitBuild(prepared);
+}
+
+bool Shader::poll()
+{
+  if (!m_building)
+    return false;
+
+  // without the extension the status query below blocks until the driver is done
+  if (parallel_compile_supported())
+  {
+    GLint completed = GL_FALSE;
+    glGetProgramiv(m_building, GL_COMPLETION_STATUS_KHR, &completed);
+    if (completed != GL_TRUE)
+      return false;
+  }
+
+  return finishBuild();
+}
+
+bool Shader::startBuild()
+{
+  // a newer build supersedes the one still in flight
+  if (glIsProgram(m_building))
+    glDeleteProgram(m_building);
+  m_building = 0;
+
+  Prepared prepared;
+  for (const auto &[type, source] : m_sources)
+  {
+    const auto file = m_files.find(type);
+    const std::filesystem::path origin = file != m_files.end() ? file->second : std::filesystem::path();
+
+    if (!preprocess(source, origin, m_defines, prepared.code[type], prepared.includes))
+      return false;
+  }
+  m_includes = std::move(prepared.includes);
+
+  prepared.key = cacheKey(prepared.code, driver_hash());
+  readBinary(prepared.key, prepared.format, prepared.binary);
+  return submitBuild(prepared);
+}
+
+bool Shader::submitBuild(const Prepared &prepared)
+{
+  if (glIsProgram(m_building))
+    glDeleteProgram(m_building);
+
+  m_building = glCreateProgram();
+  m_buildKey = prepared.key;
+  m_buildCached = loadBinary(m_building, prepared);
+  if (m_buildCached)
+    return true;
+
+  // no status query until the link is complete, the driver may build on its own threads meanwhile
+  for (auto &[type, source] : prepared.code)
+  {
+    const GLuint shaderId = getOrCreate(type);
+    const char *src = source.c_str();
+
+    glShaderSource(shaderId, 1, &src, nullptr);
+    glCompileShader(shaderId);
+  }
+
+  // the driver may only keep the binary around when asked to before linking
+  if (glProgramParameteri != nullptr)
+    glProgramParameteri(m_building, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+  for (auto &[type, shader] : m_shaders)
+    if (glIsShader(shader))
+      glAttachShader(m_building, shader);
+
+  glLinkProgram(m_building);
 
   for (auto &[type, shader] : m_shaders)
     if (glIsShader(shader))
-      glAttachShader(m_program, shader);
+      glDetachShader(m_building, shader);
 
-  glLinkProgram(m_program);
+  return true;
+}
 
+bool Shader::finishBuild()
+{
   GLint result;
-  glGetProgramiv(m_program, GL_LINK_STATUS, &result);
+  glGetProgramiv(m_building, GL_LINK_STATUS, &result);
+
   if (result != GL_TRUE)
-    getProgramErrors();
+  {
+    // report the stages that failed, the link log only when they all compiled
+    bool compiled = true;
+    for (auto &[type, shader] : m_shaders)
+    {
+      GLint status = GL_TRUE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+      if (status != GL_TRUE)
+      {
+        getShaderErrors(shader);
+        compiled = false;
+      }
+    }
+    if (compiled)
+      getProgramErrors(m_building);
+
+    // the previous program, if any, stays in use
+    glDeleteProgram(m_building);
+    m_building = 0;
+    return false;
+  }
 
-  m_valid = result == GL_TRUE;
+  if (!m_buildCached)
+    saveBinary(m_building, m_buildKey);
 
-  for (auto &[type, shader] : m_shaders)
-    if (glIsShader(shader))
-      glDetachShader(m_program, shader);
+  if (glIsProgram(m_program))
+    glDeleteProgram(m_program);
+
+  m_program = m_building;
+  m_building = 0;
+  m_valid = true;
+
+  scanUniforms();
+  scanAttributes();
+  scanBlocks();
+  return true;
+}
+
+void Shader::setCacheDirectory(const std::filesystem::path &directory)
+{
+  cache_directory = directory;
+}
+
+void Shader::setCacheWriter(JobSystem *jobs)
+{
+  cache_writer = jobs;
+}
 
-  if (m_valid)
+uint64_t Shader::cacheKey(const std::map<Type, std::string> &code, uint64_t driver)
+{
+  uint64_t key = driver;
+
+  // hashed after preprocessing, so edited includes and other defines miss the cache
+  for (const auto &[type, source] : code)
   {
-    scanUniforms();
-    scanAttributes();
+    const char tag = (char)type;
+    key = fnv1a(std::string_view(&tag, 1), key);
+    key = fnv1a(source, key);
   }
+  return key;
+}
+
+static std::filesystem::path binary_path(const std::filesystem::path &directory, uint64_t key)
+{
+  char name[32];
+
+  snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+  return directory / name;
+}
+
+static bool binary_supported()
+{
+  if (glProgramBinary == nullptr || glGetProgramBinary == nullptr)
+    return false;
+
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+bool Shader::readBinary(uint64_t key, GLenum &format, std::vector<char> &binary)
+{
+  if (cache_directory.empty())
+    return false;
+
+  std::ifstream ifs(binary_path(cache_directory, key), std::ios::binary);
+  if (!ifs)
+    return false;
+
+  ifs.read((char *)&format, sizeof(format));
+  binary.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  return !binary.empty();
+}
+
+bool Shader::loadBinary(GLuint program, const Prepared &prepared)
+{
+  if (prepared.binary.empty() || !binary_supported())
+    return false;
+
+  glProgramBinary(program, prepared.format, prepared.binary.data(), (GLsizei)prepared.binary.size());
 
-  return m_valid;
+  GLint result;
+  glGetProgramiv(program, GL_LINK_STATUS, &result);
+  if (result == GL_TRUE)
+    return true;
+
+  // the driver rejected it, drop it so it gets rebuilt from the sources
+  std::error_code error;
+  std::filesystem::remove(binary_path(cache_directory, prepared.key), error);
+  return false;
+}
+
+void Shader::saveBinary(GLuint program, uint64_t key)
+{
+  if (cache_directory.empty() || !binary_supported())
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  GLenum format = 0;
+  std::vector<char> binary(length);
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  binary.resize(length);
+
+  // only the copy above needs the context, the disk is left to a job when there is a job system
+  if (cache_writer)
+    cache_writer->schedule([key, format, binary = std::move(binary)]() { writeBinary(key, format, binary); });
+  else
+    writeBinary(key, format, binary);
+}
+
+void Shader::writeBinary(uint64_t key, GLenum format, const std::vector<char> &binary)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cache_directory, error);
+
+  // written aside then renamed, so a concurrent run never reads a truncated binary
+  const std::filesystem::path path = binary_path(cache_directory, key);
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+
+  std::ofstream ofs(temporary, std::ios::binary);
+  if (!ofs)
+    return;
+
+  ofs.write((const char *)&format, sizeof(format));
+  ofs.write(binary.data(), (std::streamsize)binary.size());
+  ofs.close();
+
+  if (ofs)
+    std::filesystem::rename(temporary, path, error);
+  else
+    std::filesystem::remove(temporary, error);
 }
 
 GLuint Shader::id()
@@ -226,18 +757,50 @@ GLuint Shader::id() const
   return m_valid ? m_program : 0;
 }
 
-GLint Shader::getUniform(const std::string &name) const
+GLuint Shader::getBlockIndex(HashedName block) const
+{
+  const GLint index = m_blocks.find(block.hash);
+  return index < 0 ? GL_INVALID_INDEX : (GLuint)index;
+}
+
+GLint Shader::getBlockSize(HashedName block) const
 {
-  if (!m_uniforms.contains(name))
-    return -1;
-  return m_uniforms.at(name);
+  const GLint index = m_blocks.find(block.hash);
+  return index < 0 ? -1 : m_blockSizes[index];
 }
 
-GLint Shader::getAttribute(const std::string &name) const
+void Shader::setBlockBinding(HashedName block, GLuint binding)
 {
-  if (!m_attributes.contains(name))
-    return -1;
-  return m_attributes.at(name);
+  auto it = std::find_if(m_blockBindings.begin(), m_blockBindings.end(), [&](const auto &entry) { return entry.first == block.hash; });
+  if (it != m_blockBindings.end())
+    it->second = binding;
+  else
+    m_blockBindings.emplace_back(block.hash, binding);
+
+  const GLint index = m_blocks.find(block.hash);
+  if (m_valid && index >= 0)
+    glUniformBlockBinding(m_program, (GLuint)index, binding);
+}
+
+void Shader::LocationTable::build(const std::vector<std::pair<std::string, GLint>> &entries)
+{
+  size_t capacity = 8;
+  while (capacity < entries.size() * 2)
+    capacity <<= 1;
+
+  m_slots.assign(capacity, Slot());
+  m_mask = capacity - 1;
+
+  for (const auto &[name, location] : entries)
+  {
+    const uint64_t hash = fnv1a(name);
+
+    size_t i = hash & m_mask;
+    while (m_slots[i].hash != EMPTY && m_slots[i].hash != hash)
+      i = (i + 1) & m_mask;
+
+    m_slots[i] = { hash, location };
+  }
 }
 
 
@@ -287,6 +850,8 @@ void Shader::scanUniforms()
   GLsizei length;
   std::string name;
   std::vector<char> buffer;
+  std::vector<std::pair<std::string, GLint>> locations;
+  std::vector<std::pair<std::string, GLint>> offsets;
 
   glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniforms);
   glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longestUniform);
@@ -299,9 +864,30 @@ void Shader::scanUniforms()
     glGetActiveUniform(m_program, (GLuint)i, longestUniform, &length, &size, &type, buffer.data());
 
     name.assign(buffer.data());
-    //std::cout << "  [" << i << "]: " << name << "(" << m_uniforms[name] << ")" << std::endl;
-    m_uniforms[name] = glGetUniformLocation(m_program, name.c_str());
+
+    // block members have no location, only an offset inside their block
+    const GLuint index = (GLuint)i;
+    GLint block;
+    glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+    if (block >= 0)
+    {
+      GLint offset;
+      glGetActiveUniformsiv(m_program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+      offsets.emplace_back(name, offset);
+      continue;
+    }
+
+    const GLint location = glGetUniformLocation(m_program, name.c_str());
+    //std::cout << "  [" << i << "]: " << name << "(" << location << ")" << std::endl;
+    locations.emplace_back(name, location);
+
+    // arrays are reported as "name[0]", make them reachable by their plain name too
+    if (name.ends_with("[0]"))
+      locations.emplace_back(name.substr(0, name.size() - 3), location);
   }
+
+  m_uniforms.build(locations);
+  m_offsets.build(offsets);
 }
 
 void Shader::scanAttributes()
@@ -314,6 +900,7 @@ void Shader::scanAttributes()
   GLsizei length;
   std::string name;
   std::vector<char> buffer;
+  std::vector<std::pair<std::string, GLint>> locations;
 
   glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &attributes);
   glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &longestAttribute);
@@ -326,12 +913,46 @@ void Shader::scanAttributes()
     glGetActiveAttrib(m_program, (GLuint)i, longestAttribute, &length, &size, &type, buffer.data());
 
     name.assign(buffer.data());
-    m_attributes[name] = glGetAttribLocation(m_program, name.c_str());
-    //std::cout << "  [" << i << "]: " << name << "(" << m_attributes[name] << ")" << std::endl;
+    locations.emplace_back(name, glGetAttribLocation(m_program, name.c_str()));
+    //std::cout << "  [" << i << "]: " << name << "(" << locations.back().second << ")" << std::endl;
+  }
+
+  m_attributes.build(locations);
+}
+
+void Shader::scanBlocks()
+{
+  GLint blocks;
+  GLint longestBlock;
+
+  std::vector<char> buffer;
+  std::vector<std::pair<std::string, GLint>> indices;
+
+  glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+  glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &longestBlock);
+
+  buffer.resize(longestBlock + 1);
+  m_blockSizes.assign(blocks, 0);
+
+  for (GLint i = 0; i < blocks; ++i)
+  {
+    glGetActiveUniformBlockName(m_program, (GLuint)i, (GLsizei)buffer.size(), nullptr, buffer.data());
+    glGetActiveUniformBlockiv(m_program, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &m_blockSizes[i]);
+    indices.emplace_back(buffer.data(), i);
+  }
+
+  m_blocks.build(indices);
+
+  // linking, or loading a binary, resets every block to binding 0
+  for (const auto &[hash, binding] : m_blockBindings)
+  {
+    const GLint index = m_blocks.find(hash);
+    if (index >= 0)
+      glUniformBlockBinding(m_program, (GLuint)index, binding);
   }
 }
 
-void Shader::getProgramErrors()
+void Shader::getProgramErrors(GLuint program)
 {
   constexpr int SMALL_BUFFER_SIZE = 1024;
 
@@ -340,7 +961,7 @@ void Shader::getProgramErrors()
   std::vector<char> bigerBuffer;
   char *buffer;
 
-  glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &errorSize);
+  glGetProgramiv(program, GL_INFO_LOG_LENGTH, &errorSize);
   if (errorSize < SMALL_BUFFER_SIZE)
   {
     buffer = smallBuffer;
@@ -351,7 +972,7 @@ void Shader::getProgramErrors()
     bigerBuffer.resize(errorSize);
     buffer = bigerBuffer.data();
   }
-  glGetProgramInfoLog(m_program, errorSize, nullptr, buffer);
+  glGetProgramInfoLog(program, errorSize, nullptr, buffer);
   std::cout << "Shader linkage error: " << buffer << std::endl;
 }
 
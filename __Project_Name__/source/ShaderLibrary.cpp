@@ -0,0 +1,130 @@
+#include "ShaderLibrary.hpp"
+#include "Profiler.hpp"
+#include "ShaderReloader.hpp"
+
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+Shader &ShaderLibrary::load(const std::string &name, std::initializer_list<Stage> stages)
+{
+  Program &program = m_programs[fnv1a(name)];
+  const bool created = !program.shader;
+  if (created)
+    program = { name, std::make_unique<Shader>() };
+
+  Shader &shader = *program.shader;
+  for (const Stage &stage : stages)
+  {
+    if (!shader.addFile(stage.type, stage.file))
+      std::cout << "Shader library: " << name << " is missing its " << stage.file << " stage" << std::endl;
+  }
+
+  // submitted right away, the compile and link statuses are only read by poll() and wait()
+  if (!shader.compileAsync())
+    ++m_failed;
+  else if (std::find(m_pending.begin(), m_pending.end(), &shader) == m_pending.end())
+    m_pending.push_back(&shader);
+
+  // added once its includes are known, reloading takes care of them from then on
+  if (created && m_reloader)
+    m_reloader->add(shader);
+
+  return shader;
+}
+
+Shader *ShaderLibrary::get(HashedName name) const
+{
+  const auto it = m_programs.find(name.hash);
+  return it == m_programs.end() ? nullptr : it->second.shader.get();
+}
+
+Shader *ShaderLibrary::variant(const std::string &name, const Shader::Defines &defines)
+{
+  const uint64_t base = fnv1a(name);
+  const uint64_t key = Shader::permutationHash(defines, base);
+
+  const auto existing = m_programs.find(key);
+  if (existing != m_programs.end())
+    return existing->second.shader.get();
+
+  const auto original = m_programs.find(base);
+  if (original == m_programs.end())
+    return nullptr;
+
+  std::string label = name + " [";
+  for (const auto &[define, value] : defines)
+    label += (label.back() == '[' ? "" : " ") + define + (value.empty() ? "" : "=" + value);
+  label += "]";
+
+  // inserting may rehash, only the shader it points to is stable
+  Shader &source = *original->second.shader;
+  Program &program = m_programs[key];
+  program = { label, std::make_unique<Shader>(source.permute(defines)) };
+
+  if (!program.shader->compileAsync())
+    ++m_failed;
+  else
+    m_pending.push_back(program.shader.get());
+
+  // the base was registered long ago, an edit of the files they share must rebuild this one too
+  if (m_reloader)
+    m_reloader->add(*program.shader);
+
+  return program.shader.get();
+}
+
+bool ShaderLibrary::poll()
+{
+  std::erase_if(m_pending, [this](Shader *shader) {
+    const bool swapped = shader->poll();
+    if (shader->building())
+      return false;
+
+    if (!swapped)
+      ++m_failed;
+    return true;
+  });
+
+  return m_pending.empty();
+}
+
+size_t ShaderLibrary::wait()
+{
+  PROFILE_SCOPE("shaders.wait");
+
+  // round robin over the programs, each finishes in whatever order the driver completes them
+  while (!poll())
+    std::this_thread::yield();
+
+  const size_t failed = m_failed;
+  m_failed = 0;
+  return failed;
+}
+
+void ShaderLibrary::forEach(const std::function<void(const std::string &, Shader &)> &function) const
+{
+  for (const auto &[_, program] : m_programs)
+    function(program.name, *program.shader);
+}
+
+void ShaderLibrary::watch(ShaderReloader *reloader)
+{
+  for (const auto &[_, program] : m_programs)
+  {
+    if (m_reloader)
+      m_reloader->remove(*program.shader);
+    if (reloader)
+      reloader->add(*program.shader);
+  }
+
+  m_reloader = reloader;
+}
+
+void ShaderLibrary::clear()
+{
+  watch(nullptr);
+  m_pending.clear();
+  m_programs.clear();
+  m_failed = 0;
+}
@@ -0,0 +1,114 @@
+#include "ShaderReloader.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+void ShaderReloader::start()
+{
+  m_watcher.start([this](const std::filesystem::path &file) { onChange(file); });
+}
+
+void ShaderReloader::stop()
+{
+  m_watcher.stop();
+
+  std::lock_guard guard(m_lock);
+  m_reloads.clear();
+}
+
+void ShaderReloader::add(Shader &shader)
+{
+  std::lock_guard guard(m_lock);
+
+  m_entries.push_back({ &shader, shader.files(), shader.includes(), shader.defines() });
+  for (const auto &[_, file] : shader.files())
+    m_watcher.watch(file);
+  for (const std::filesystem::path &file : shader.includes())
+    m_watcher.watch(file);
+}
+
+void ShaderReloader::remove(Shader &shader)
+{
+  std::lock_guard guard(m_lock);
+
+  std::erase_if(m_entries, [&](const Entry &entry) { return entry.shader == &shader; });
+  std::erase_if(m_reloads, [&](const Reload &reload) { return reload.shader == &shader; });
+  std::erase(m_building, &shader);
+}
+
+void ShaderReloader::update()
+{
+  PROFILE_SCOPE("shader.reload");
+
+  std::vector<Reload> reloads;
+  {
+    std::lock_guard guard(m_lock);
+    reloads.swap(m_reloads);
+  }
+
+  // only the GL calls happen here, they return before the driver is done compiling
+  for (Reload &reload : reloads)
+  {
+    if (!reload.shader->compileAsync(std::move(reload.prepared)))
+    {
+      m_failed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    if (std::find(m_building.begin(), m_building.end(), reload.shader) == m_building.end())
+      m_building.push_back(reload.shader);
+  }
+
+  std::erase_if(m_building, [this](Shader *shader) {
+    const bool swapped = shader->poll();
+    if (shader->building())
+      return false;
+
+    (swapped ? m_reloaded : m_failed).fetch_add(1, std::memory_order_relaxed);
+    return true;
+  });
+}
+
+void ShaderReloader::onChange(const std::filesystem::path &file)
+{
+  std::vector<Entry> affected;
+  bool included = false;
+  {
+    std::lock_guard guard(m_lock);
+    for (const Entry &entry : m_entries)
+    {
+      const bool includes = std::find(entry.includes.begin(), entry.includes.end(), file) != entry.includes.end();
+      if (includes || std::any_of(entry.files.begin(), entry.files.end(), [&](const auto &pair) { return pair.second == file; }))
+        affected.push_back(entry);
+      included |= includes;
+    }
+  }
+
+  // preprocessing reads includes from memory, refresh the cached copy first
+  if (included)
+    Shader::reloadInclude(file);
+
+  // read and preprocessed without the lock, update() never waits on the disk
+  for (const Entry &entry : affected)
+  {
+    // every stage is re-read so the program is rebuilt from a consistent set of files,
+    // a file caught mid-save is picked up by the next event
+    Reload reload = { entry.shader, {} };
+    if (!Shader::prepare(entry.files, entry.defines, reload.prepared))
+      continue;
+
+    std::lock_guard guard(m_lock);
+    const auto current = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry &current) { return current.shader == entry.shader; });
+    if (current == m_entries.end())
+      continue;
+
+    // an edit may have pulled in new includes
+    for (const std::filesystem::path &include : reload.prepared.includes)
+      if (std::find(current->includes.begin(), current->includes.end(), include) == current->includes.end())
+        m_watcher.watch(include);
+    current->includes = reload.prepared.includes;
+
+    std::erase_if(m_reloads, [&](const Reload &pending) { return pending.shader == entry.shader; });
+    m_reloads.push_back(std::move(reload));
+  }
+}
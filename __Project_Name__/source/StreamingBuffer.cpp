@@ -0,0 +1,130 @@
+#include "StreamingBuffer.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+bool StreamingBuffer::create(GLsizeiptr frameSize, GLsizeiptr alignment)
+{
+  destroy();
+
+  m_alignment = std::max<GLsizeiptr>(1, alignment);
+
+  // every region starts aligned so offsets can be bound directly
+  m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+  const GLsizeiptr size = m_frameSize * FRAMES;
+
+  // uploads go through the copy target so they never disturb vertex array or index bindings
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+  if (glBufferStorage != nullptr)
+  {
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    m_mapped = (uint8_t *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+
+    // immutable storage can't be respecified, the fallback needs a buffer of its own
+    if (!m_mapped)
+    {
+      glDeleteBuffers(1, &m_buffer);
+      glGenBuffers(1, &m_buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    }
+  }
+
+  if (!m_mapped)
+  {
+    glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    m_staging.resize(m_frameSize);
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  m_frame = 0;
+  m_cursor = 0;
+  m_flushed = 0;
+  return glIsBuffer(m_buffer);
+}
+
+void StreamingBuffer::destroy()
+{
+  for (GLsync &fence : m_fences)
+  {
+    if (fence)
+      glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  if (m_mapped)
+  {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_mapped = nullptr;
+  }
+
+  if (glIsBuffer(m_buffer))
+    glDeleteBuffers(1, &m_buffer);
+
+  m_buffer = 0;
+  m_staging.clear();
+}
+
+void StreamingBuffer::beginFrame()
+{
+  m_frame = (m_frame + 1) % FRAMES;
+  m_cursor = 0;
+  m_flushed = 0;
+
+  GLsync &fence = m_fences[m_frame];
+  if (!fence)
+    return;
+
+  PROFILE_SCOPE("streaming.wait");
+
+  // the first wait flushes so the fence is guaranteed to signal eventually
+  GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+  while (glClientWaitSync(fence, flags, 1000000000) == GL_TIMEOUT_EXPIRED)
+    flags = 0;
+
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void StreamingBuffer::endFrame()
+{
+  if (!m_buffer)
+    return;
+
+  flush();
+  m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::allocate(GLsizeiptr size)
+{
+  const GLsizeiptr aligned = (size + m_alignment - 1) / m_alignment * m_alignment;
+  if (m_cursor + aligned > m_frameSize)
+    return {};
+
+  Allocation allocation;
+  allocation.offset = regionBegin() + m_cursor;
+  allocation.size = size;
+  allocation.data = m_mapped ? m_mapped + allocation.offset : m_staging.data() + m_cursor;
+
+  m_cursor += aligned;
+  return allocation;
+}
+
+void StreamingBuffer::flush()
+{
+  // coherent mappings are visible to the GPU as soon as they are written
+  if (m_mapped || m_flushed == m_cursor)
+    return;
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, regionBegin() + m_flushed, m_cursor - m_flushed, m_staging.data() + m_flushed);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  m_flushed = m_cursor;
+}
@@ -5,13 +5,40 @@
 #include <glad/gl.h>
 #include <glm/ext.hpp> // glm::perspective
 
+#include <cmath>
+#include <algorithm>
+
+namespace chrono = std::chrono;
+using seconds = chrono::duration<double>;
+
+// weight of the newest frame in the moving averages
+static constexpr double SMOOTHING = 0.05;
+
+// low latency frames are started this many deviations of the render time, plus the margin, ahead of the swap
+static constexpr double LATENCY_DEVIATIONS = 2.0;
+static constexpr double LATENCY_MARGIN = 0.001;
+
 // event propagation
 
-Window::Window(Application &app) noexcept : m_app(app), m_handle(nullptr) {}
+Window::Window(Application &app) noexcept : m_app(app), m_handle(nullptr), m_input(std::make_unique<Input>()) {}
 
-Window::Window(Window &&mv) noexcept : m_app(mv.m_app), m_handle(mv.m_handle)
+Window::Window(Window &&mv) noexcept :
+  m_app(mv.m_app),
+  m_handle(mv.m_handle),
+  m_input(std::move(mv.m_input)),
+  m_mode(mv.m_mode),
+  m_size(mv.m_size),
+  m_framebuffer(mv.m_framebuffer),
+  m_colorbuffer(mv.m_colorbuffer),
+  m_depthbuffer(mv.m_depthbuffer),
+  m_pacing(mv.m_pacing.load()),
+  m_targetFps(mv.m_targetFps.load()),
+  m_refreshInterval(mv.m_refreshInterval.load())
 {
   mv.m_handle = nullptr;
+  mv.m_framebuffer = 0;
+  mv.m_colorbuffer = 0;
+  mv.m_depthbuffer = 0;
 }
 
 Window::~Window() noexcept
@@ -25,13 +52,43 @@ Window::operator GLFWwindow *() const
 }
 
 
-bool Window::create(const std::string_view title, int width, int height)
+bool Window::create(const std::string_view title, int width, int height, Mode mode)
 {
+  m_mode = mode;
+  m_size = { width, height };
+
   //glfwWindowHint(GLFW_DOUBLEBUFFER, true);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
-  m_handle = glfwCreateWindow(1280, 720, title.data(), nullptr, nullptr);
+  if (mode == Mode::headless)
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+  // compute shaders need a 4.3 core context, everything else runs on 3.3
+  constexpr int versions[][3] = {
+    { 4, 3, GLFW_OPENGL_CORE_PROFILE },
+    { 3, 3, GLFW_OPENGL_ANY_PROFILE },
+  };
+
+  for (const auto &[major, minor, profile] : versions)
+  {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, profile);
+
+    m_handle = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
+
+#ifdef GLFW_EGL_CONTEXT_API
+    // the null platform defaults to OSMesa, which recent Mesa releases dropped in favor of surfaceless EGL
+    if (!m_handle && mode == Mode::headless)
+    {
+      glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+      m_handle = glfwCreateWindow(width, height, title.data(), nullptr, nullptr);
+    }
+#endif
+
+    if (m_handle)
+      break;
+  }
+
   if (!m_handle)
     return false;
 
@@ -46,6 +103,14 @@ bool Window::create(const std::string_view title, int width, int height)
   if (glGetString == nullptr)
     gladLoadGL(glfwGetProcAddress);
 
+  if (mode == Mode::headless && !createFramebuffer())
+  {
+    clear();
+    return false;
+  }
+
+  m_refreshInterval = 1.0 / refreshRate();
+
   m_app.onResize(*this, width, height);
   return true;
 }
@@ -55,13 +120,60 @@ void Window::update()
   glfwPollEvents();
 }
 
+void Window::waitEvents(double timeout)
+{
+  glfwWaitEventsTimeout(timeout);
+}
+
+void Window::wake()
+{
+  glfwPostEmptyEvent();
+}
+
 void Window::render()
 {
+  const Pacing pacing = m_pacing.load(std::memory_order_relaxed);
+
+  // nothing to present offscreen, only make sure the frame is actually rendered
+  if (m_mode == Mode::headless)
+  {
+    glFlush();
+    recordFrame(clock::now(), clock::now());
+    return;
+  }
+
+  const int interval = (pacing == Pacing::vsync || pacing == Pacing::lowLatency) ? 1 : 0;
+  if (interval != m_swapInterval)
+  {
+    glfwSwapInterval(interval);
+    m_swapInterval = interval;
+  }
+
+  // the render time has to include the GPU, and the swap has to return with the flip rather than queue
+  // the frame, or the next one would be started against a vblank that is already gone
+  if (pacing == Pacing::lowLatency)
+    glFinish();
+  const clock::time_point rendered = clock::now();
+
   glfwSwapBuffers(m_handle);
+  if (pacing == Pacing::lowLatency)
+    glFinish();
+
+  recordFrame(rendered, clock::now());
 }
 
 void Window::clear()
 {
+  if (m_framebuffer)
+  {
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteRenderbuffers(1, &m_colorbuffer);
+    glDeleteRenderbuffers(1, &m_depthbuffer);
+  }
+  m_framebuffer = 0;
+  m_colorbuffer = 0;
+  m_depthbuffer = 0;
+
   if (m_handle)
     glfwDestroyWindow(m_handle);
   m_handle = nullptr;
@@ -79,12 +191,109 @@ bool Window::isOpen() const
 
 void Window::setVSync(bool enabled)
 {
-  glfwSwapInterval(enabled ? 1 : 0);
+  setPacing(enabled ? Pacing::vsync : Pacing::uncapped);
+}
+
+void Window::setPacing(Pacing pacing, double targetFps)
+{
+  if (targetFps > 0.0)
+    m_targetFps.store(targetFps, std::memory_order_relaxed);
+  m_pacing.store(pacing, std::memory_order_relaxed);
+}
+
+double Window::refreshRate() const
+{
+  GLFWmonitor *monitor = m_handle ? glfwGetWindowMonitor(m_handle) : nullptr;
+  if (!monitor)
+    monitor = glfwGetPrimaryMonitor();
+
+  const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+  return (mode && mode->refreshRate > 0) ? mode->refreshRate : 60.0;
+}
+
+void Window::beginFrame()
+{
+  m_frameStart = clock::now();
+}
+
+Window::clock::time_point Window::nextFrame(clock::time_point lastStart) const
+{
+  switch (m_pacing.load(std::memory_order_relaxed))
+  {
+  case Pacing::target:
+    return lastStart + chrono::duration_cast<clock::duration>(seconds(1.0 / m_targetFps.load(std::memory_order_relaxed)));
+
+  case Pacing::lowLatency:
+  {
+    if (m_presented == clock::time_point())
+      return lastStart;
+
+    // the swap returned with the last vblank, the next one is a refresh later: start just in time to make it
+    const seconds budget(m_renderMean + LATENCY_DEVIATIONS * m_renderDeviation + LATENCY_MARGIN);
+    const seconds wait = std::max(seconds(m_refreshInterval.load(std::memory_order_relaxed)) - budget, seconds::zero());
+    return m_presented + chrono::duration_cast<clock::duration>(wait);
+  }
+
+  default:
+    return lastStart;
+  }
+}
+
+Window::Latency Window::latency() const
+{
+  return {
+    clock::duration(m_lastLatency.load(std::memory_order_relaxed)),
+    clock::duration(m_meanLatency.load(std::memory_order_relaxed)),
+    clock::duration(m_maxLatency.load(std::memory_order_relaxed)),
+    clock::duration(m_meanRender.load(std::memory_order_relaxed)),
+    m_frames.load(std::memory_order_relaxed)
+  };
+}
+
+void Window::recordFrame(clock::time_point rendered, clock::time_point presented)
+{
+  m_presented = presented;
+
+  // frames started before beginFrame() was ever called have nothing to measure against
+  if (m_frameStart == clock::time_point())
+    return;
+
+  const double render = seconds(rendered - m_frameStart).count();
+  const uint64_t frames = m_frames.load(std::memory_order_relaxed);
+
+  if (frames == 0)
+    m_renderMean = render;
+  m_renderDeviation += (std::abs(render - m_renderMean) - m_renderDeviation) * SMOOTHING;
+  m_renderMean += (render - m_renderMean) * SMOOTHING;
+
+  const clock::rep latency = (presented - m_frameStart).count();
+  const double mean = frames ? (double)m_meanLatency.load(std::memory_order_relaxed) : (double)latency;
+
+  m_lastLatency.store(latency, std::memory_order_relaxed);
+  m_meanLatency.store((clock::rep)(mean + (latency - mean) * SMOOTHING), std::memory_order_relaxed);
+  m_maxLatency.store(std::max(m_maxLatency.load(std::memory_order_relaxed), latency), std::memory_order_relaxed);
+  m_meanRender.store(chrono::duration_cast<clock::duration>(seconds(m_renderMean)).count(), std::memory_order_relaxed);
+  m_frames.store(frames + 1, std::memory_order_relaxed);
 }
 
 void Window::grabRenderingContext()
 {
   glfwMakeContextCurrent(m_handle);
+
+  if (m_framebuffer)
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+}
+
+bool Window::readPixels(std::vector<uint8_t> &pixels) const
+{
+  if (!m_handle)
+    return false;
+
+  pixels.resize((size_t)m_size.x * m_size.y * 4);
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, m_size.x, m_size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  return glGetError() == GL_NO_ERROR;
 }
 
 void Window::releaseRenderingContext()
@@ -94,6 +303,24 @@ void Window::releaseRenderingContext()
 
 
 
+bool Window::createFramebuffer()
+{
+  glGenRenderbuffers(1, &m_colorbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_colorbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_size.x, m_size.y);
+
+  glGenRenderbuffers(1, &m_depthbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_depthbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_size.x, m_size.y);
+
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthbuffer);
+
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
 void Window::initEventCallbacks()
 {
   glfwSetWindowUserPointer(m_handle, this);
@@ -103,14 +330,27 @@ void Window::initEventCallbacks()
     return window->m_app.onResize(*window, width, height);
   });
 
+  // recorded first, so the snapshots already see the events the handlers react to
   glfwSetMouseButtonCallback(m_handle, [](GLFWwindow *ptr, int button, int action, int mods)
   {
     Window *window = (Window *)glfwGetWindowUserPointer(ptr);
+    window->m_input->button(button, action, mods);
     return window->m_app.onClick(*window, button, action, mods);
   });
 
   glfwSetKeyCallback(m_handle, [](GLFWwindow *ptr, int key, int scancode, int action, int mods) {
     Window *window = (Window *)glfwGetWindowUserPointer(ptr);
+    window->m_input->key(key, action, mods);
     return window->m_app.onKeyboard(*window, key, scancode, action, mods);
   });
+
+  glfwSetCursorPosCallback(m_handle, [](GLFWwindow *ptr, double x, double y) {
+    Window *window = (Window *)glfwGetWindowUserPointer(ptr);
+    window->m_input->cursor(x, y);
+  });
+
+  glfwSetScrollCallback(m_handle, [](GLFWwindow *ptr, double x, double y) {
+    Window *window = (Window *)glfwGetWindowUserPointer(ptr);
+    window->m_input->scroll(x, y);
+  });
 }
\ No newline at end of file
@@ -1,9 +1,56 @@
 #include "App.hpp"
 
-int main()
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+// a headless window can't be closed, so a run without a frame count still has to end
+static constexpr uint64_t HEADLESS_FRAMES = 600;
+
+int main(int argc, char **argv)
 {
+  Window::Mode mode = Window::Mode::windowed;
+  uint64_t frames = 0;
+  const char *dump = nullptr;
+
+  // --headless [frames]: render offscreen, on machines without a display or GPU
+  // --dump <file>: write the last headless frame as a PPM image
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--headless") == 0)
+    {
+      mode = Window::Mode::headless;
+      frames = HEADLESS_FRAMES;
+      if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+        frames = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+      dump = argv[++i];
+    else
+    {
+      fprintf(stderr, "Usage: %s [--headless [frames]] [--dump <file>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (mode == Window::Mode::headless && frames == 0)
+  {
+    fprintf(stderr, "Error: a headless run needs at least one frame\n");
+    return 1;
+  }
+
+  if (dump && mode != Window::Mode::headless)
+  {
+    fprintf(stderr, "Error: --dump needs --headless\n");
+    return 1;
+  }
+
   App app;
 
-  app.run();
+  if (dump)
+    app.setFrameDump(dump);
+
+  app.run(mode, frames);
   return 0;
 }
@@ -22,6 +22,12 @@ outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 --vectorextensions "SSE3"
 --vectorextensions "SSE4.1"
 --vectorextensions "SSE4.2"
+--vectorextensions "AVX" -- Frustum culling tests 8 volumes per instruction instead of 4
+
+newoption {
+  trigger = "track-allocations",
+  description = "Count heap allocations per thread and frame phase (replaces the global operator new)"
+}
 
 defines {
   "_CRT_SECURE_NO_WARNINGS", -- Disable windows warnings about stdlib functions